@@ -0,0 +1,50 @@
+QT       += core gui concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++1z console
+CONFIG -= app_bundle
+
+TARGET = bench
+
+# Benchmarks are built with Google Benchmark (https://github.com/google/benchmark)
+LIBS += -lbenchmark -lpthread
+
+DEFINES += QT_DEPRECATED_WARNINGS QT_NO_DEBUG_OUTPUT QT_NO_WARNING_OUTPUT QT_NO_INFO_OUTPUT
+DEFINES += EXAMPLES_DIR=\\\"$$PWD/../examples\\\"
+
+INCLUDEPATH += ../src
+
+SOURCES += \
+    benchmarks.cpp \
+    ../src/alternativeroutes.cpp \
+    ../src/contractionhierarchy.cpp \
+    ../src/dstarlite.cpp \
+    ../src/eventsimulation.cpp \
+    ../src/legcache.cpp \
+    ../src/pathfinding.cpp \
+    ../src/pickindex.cpp \
+    ../src/profiler.cpp \
+    ../src/routecachefile.cpp \
+    ../src/scene.cpp \
+    ../src/simulationworker.cpp \
+    ../src/spatialgrid.cpp \
+    ../src/tracer.cpp
+
+HEADERS += \
+    ../src/alternativeroutes.h \
+    ../src/commandqueue.h \
+    ../src/contractionhierarchy.h \
+    ../src/datastructures.h \
+    ../src/dstarlite.h \
+    ../src/eventsimulation.h \
+    ../src/legcache.h \
+    ../src/pathfinding.h \
+    ../src/pickindex.h \
+    ../src/profiler.h \
+    ../src/routecachefile.h \
+    ../src/scene.h \
+    ../src/simulationworker.h \
+    ../src/spatialgrid.h \
+    ../src/tracer.h \
+    ../src/triplebuffer.h
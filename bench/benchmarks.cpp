@@ -0,0 +1,405 @@
+/*!
+ * @file benchmarks.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Microbenchmarks of path finding, simulation and map loading
+ */
+
+#include <benchmark/benchmark.h>
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "scene.h"
+
+/*!
+ * \brief creates coordinates of a point in a square grid
+ */
+static std::tuple<int,int> gridPoint(int i, int j)
+{
+    return std::tuple<int,int>(i*50, j*50);
+}
+
+/*!
+ * \brief creates streets of a square grid (one street per row and per column)
+ * \param size number of points in a row
+ * \param streets
+ * \param points receives all points of the grid
+ */
+static void gridStreets(int size, QMap<QString, street>& streets, QVector<std::tuple<int,int>>& points)
+{
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            points.push_back(gridPoint(i, j));
+
+    for (int k = 0; k < size; ++k)
+    {
+        street row;
+        street column;
+        row.name = QString("Row %1").arg(k);
+        column.name = QString("Column %1").arg(k);
+        for (int l = 1; l < size; ++l)
+        {
+            row.pathLines.push_back(std::tuple_cat(gridPoint(l-1, k), gridPoint(l, k)));
+            column.pathLines.push_back(std::tuple_cat(gridPoint(k, l-1), gridPoint(k, l)));
+        }
+        streets.insert(row.name, row);
+        streets.insert(column.name, column);
+    }
+}
+
+/*!
+ * \brief writes a map of a square grid with stops in every point
+ * \param size number of points in a row
+ * \param busEntries number of bus entries (every entry creates 10 buses)
+ * \return path to the map file
+ */
+static QString writeGridMap(int size, int busEntries)
+{
+    auto stopName = [](int i, int j) {return QString("Stop %1-%2").arg(i).arg(j);};
+    auto point = [](int i, int j) {return QJsonArray {i*50, j*50};};
+
+    QJsonArray stops;
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            stops.append(QJsonObject {{"name", stopName(i, j)}, {"x", i*50}, {"y", j*50}});
+
+    QJsonArray streets;
+    for (int k = 0; k < size; ++k)
+    {
+        QJsonArray rowMid;
+        QJsonArray columnMid;
+        for (int l = 1; l < size - 1; ++l)
+        {
+            rowMid.append(point(l, k));
+            columnMid.append(point(k, l));
+        }
+        streets.append(QJsonObject {{"name", QString("Row %1").arg(k)}, {"start", point(0, k)}, {"mid", rowMid}, {"end", point(size-1, k)}});
+        streets.append(QJsonObject {{"name", QString("Column %1").arg(k)}, {"start", point(k, 0)}, {"mid", columnMid}, {"end", point(k, size-1)}});
+    }
+
+    const int lineCount = size;
+    QJsonArray lines;
+    for (int k = 0; k < lineCount; ++k)
+    {
+        lines.append(QJsonObject {{"no", k + 1}, {"color", "red"}, {"start", stopName(0, k)},
+                                  {"goes", QJsonArray {stopName(size/2, size/2)}}, {"end", stopName(size-1, size-1-k)}});
+    }
+
+    QJsonArray buses;
+    for (int b = 0; b < busEntries; ++b)
+        buses.append(QJsonObject {{"no", b + 1}, {"lineno", b % lineCount + 1}, {"startat", b % 10}});
+
+    QJsonObject map {{"lines", lines}, {"stops", stops}, {"streets", streets}, {"buses", buses}};
+
+    auto path = QDir::temp().filePath(QString("icp_bench_grid_%1_%2.json").arg(size).arg(busEntries));
+    QFile file(path);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    file.write(QJsonDocument(map).toJson(QJsonDocument::Compact));
+    return path;
+}
+
+
+static void BM_LoadPaths(benchmark::State& state)
+{
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(state.range(0), streets, points);
+
+    for (auto _ : state)
+    {
+        Pathfinding p;
+        p.loadPoints(points);
+        p.loadPaths(streets);
+        benchmark::DoNotOptimize(p.getGraph().size());
+    }
+}
+BENCHMARK(BM_LoadPaths)->Arg(8)->Arg(16)->Arg(32)->Unit(benchmark::kMillisecond);
+
+
+static void BM_SolveAStar(benchmark::State& state)
+{
+    const int size = state.range(0);
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(size, streets, points);
+
+    Pathfinding p;
+    p.loadPoints(points);
+    p.loadPaths(streets);
+
+    for (auto _ : state)
+    {
+        p.loadGoal(gridPoint(0, 0), gridPoint(size-1, size-1));
+        p.solveAStar();
+        benchmark::DoNotOptimize(p.getSolution());
+    }
+    state.counters["nodes"] = p.getGraph().size();
+    state.counters["edges"] = p.getEdges().size();
+}
+BENCHMARK(BM_SolveAStar)->Arg(8)->Arg(16)->Arg(32)->Unit(benchmark::kMicrosecond);
+
+
+static void BM_SolveHierarchy(benchmark::State& state)
+{
+    const int size = state.range(0);
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(size, streets, points);
+
+    Pathfinding p;
+    p.loadPoints(points);
+    p.loadPaths(streets);
+    ContractionHierarchy ch;
+    ch.build(p);
+
+    for (auto _ : state)
+    {
+        ch.loadGoal(gridPoint(0, 0), gridPoint(size-1, size-1));
+        ch.solve();
+        benchmark::DoNotOptimize(ch.getSolution());
+    }
+    state.counters["nodes"] = p.getGraph().size();
+    state.counters["edges"] = p.getEdges().size();
+}
+BENCHMARK(BM_SolveHierarchy)->Arg(8)->Arg(16)->Arg(32)->Unit(benchmark::kMicrosecond);
+
+
+/*!
+ * \brief selects stops evenly spread over a square grid
+ * \param size number of points in a row of the grid
+ * \param count number of stops in a row
+ * \return coordinates of stops
+ */
+static QVector<std::tuple<int,int>> gridStops(int size, int count)
+{
+    QVector<std::tuple<int,int>> stops;
+    for (int i = 0; i < count; ++i)
+        for (int j = 0; j < count; ++j)
+            stops.push_back(gridPoint(i * (size-1) / std::max(1, count-1), j * (size-1) / std::max(1, count-1)));
+    return stops;
+}
+
+
+static void BM_StopDistances(benchmark::State& state)
+{
+    const int size = 32;
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(size, streets, points);
+    const auto stops = gridStops(size, state.range(0));
+
+    Pathfinding p;
+    p.loadPoints(points);
+    p.loadPaths(streets);
+    ContractionHierarchy ch;
+    ch.build(p);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ch.distanceMatrix(stops, stops));
+    }
+    state.SetItemsProcessed(state.iterations() * stops.size() * stops.size());
+}
+BENCHMARK(BM_StopDistances)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMillisecond);
+
+
+static void BM_StopDistancesAStar(benchmark::State& state)
+{
+    const int size = 32;
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(size, streets, points);
+    const auto stops = gridStops(size, state.range(0));
+
+    Pathfinding p;
+    p.loadPoints(points);
+    p.loadPaths(streets);
+
+    // the same matrix as BM_StopDistances, one search per pair of stops
+    for (auto _ : state)
+    {
+        QVector<float> matrix(stops.size() * stops.size(), INFINITY);
+        for (int i = 0; i < stops.size(); ++i)
+        {
+            for (int j = 0; j < stops.size(); ++j)
+            {
+                p.loadGoal(stops[i], stops[j]);
+                if (p.solveAStar()) matrix[i * stops.size() + j] = p.getSolutionCost();
+            }
+        }
+        benchmark::DoNotOptimize(matrix);
+    }
+    state.SetItemsProcessed(state.iterations() * stops.size() * stops.size());
+}
+BENCHMARK(BM_StopDistancesAStar)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMillisecond);
+
+
+static void BM_PickStreet(benchmark::State& state)
+{
+    const int size = state.range(0);
+    QMap<QString, street> streets;
+    QVector<std::tuple<int,int>> points;
+    gridStreets(size, streets, points);
+
+    PickIndex index;
+    auto key = 0;
+    for (const auto& street : streets)
+        index.addStreet(key++, street.pathLines);
+    index.build(QRectF(0, 0, size*50, size*50));
+    SpatialGrid noBuses;
+
+    // clicks next to streets, between them and on crossings
+    auto i = 0;
+    for (auto _ : state)
+    {
+        auto offset = (i % 3) * 12.0;
+        benchmark::DoNotOptimize(index.pick(QPointF((i % size) * 50 + offset, (i / size % size) * 50 + 2), 4, noBuses));
+        ++i;
+    }
+}
+BENCHMARK(BM_PickStreet)->Arg(8)->Arg(32)->Arg(128)->Unit(benchmark::kMicrosecond);
+
+
+static void BM_Simulate(benchmark::State& state)
+{
+    const int busCount = state.range(0);
+    Scene scene(nullptr, writeGridMap(8, std::max(1, busCount / 10)));
+
+    for (auto _ : state)
+    {
+        scene.simulate();
+    }
+    state.SetItemsProcessed(state.iterations() * busCount);
+}
+BENCHMARK(BM_Simulate)->Arg(10)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+
+static void BM_JumpHour(benchmark::State& state)
+{
+    const int busCount = state.range(0);
+    Scene scene(nullptr, writeGridMap(8, std::max(1, busCount / 10)));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(scene.jumpTo(3600));
+    }
+    state.SetItemsProcessed(state.iterations() * busCount);
+}
+BENCHMARK(BM_JumpHour)->Arg(10)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+
+static void BM_LoadExample(benchmark::State& state, const char* file)
+{
+    auto path = QDir(EXAMPLES_DIR).filePath(file);
+
+    for (auto _ : state)
+    {
+        Scene scene(nullptr, path);
+    }
+}
+BENCHMARK_CAPTURE(BM_LoadExample, city, "city.json")->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_LoadExample, square_town, "square_town.json")->Unit(benchmark::kMillisecond);
+
+
+static void BM_BlockUnblock(benchmark::State& state)
+{
+    Scene scene(nullptr, QDir(EXAMPLES_DIR).filePath("city.json"));
+    const auto name = scene.getStreets().firstKey();
+
+    for (auto _ : state)
+    {
+        scene.blockStreet(name);
+        scene.resetTime();
+        scene.unblockStreet(name);
+        scene.resetTime();
+    }
+}
+BENCHMARK(BM_BlockUnblock)->Unit(benchmark::kMillisecond);
+
+
+static void BM_BlockReroute(benchmark::State& state)
+{
+    Scene scene(nullptr, QDir(EXAMPLES_DIR).filePath("city.json"));
+    const auto name = scene.getStreets().firstKey();
+
+    // buses leave their start stations first, so closures reroute them on the road
+    scene.skip(60000);
+
+    for (auto _ : state)
+    {
+        scene.blockStreet(name);
+        scene.unblockStreet(name);
+    }
+}
+BENCHMARK(BM_BlockReroute)->Unit(benchmark::kMillisecond);
+
+
+static void BM_BlockUnblockDeparts(benchmark::State& state)
+{
+    Scene scene(nullptr, QDir(EXAMPLES_DIR).filePath("city.json"));
+    auto halted = [&scene]() {
+        auto count = 0;
+        for (const auto& bus : scene.getBuses())
+            if (bus.halt) ++count;
+        return count;
+    };
+    const auto before = halted();
+
+    // all buses still wait in their start stations, every closure which halts a line is lifted again
+    for (auto _ : state)
+    {
+        for (const auto& name : scene.getStreets().keys())
+        {
+            scene.blockStreet(name);
+            scene.unblockStreet(name);
+        }
+    }
+
+    if (halted() != before)
+        state.SkipWithError("buses waiting in start stations stay halted after streets were opened");
+}
+BENCHMARK(BM_BlockUnblockDeparts)->Unit(benchmark::kMillisecond);
+
+
+static void BM_PostCommands(benchmark::State& state)
+{
+    const int count = state.range(0);
+    Scene scene(nullptr, QDir(EXAMPLES_DIR).filePath("city.json"));
+
+    QVector<command> batch;
+    for (int i = 0; i < count; ++i)
+    {
+        command c(command::SetSpeed);
+        c.value = i % 2;
+        batch.push_back(c);
+    }
+
+    for (auto _ : state)
+    {
+        scene.post(batch);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_PostCommands)->Arg(1)->Arg(100)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+
+/*!
+ * \brief Runs all benchmarks, scene needs a running QApplication.
+ * \details Use --benchmark_out=<file> --benchmark_out_format=json for machine-readable results.
+ */
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication a(argc, argv);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
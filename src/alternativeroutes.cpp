@@ -0,0 +1,112 @@
+/*!
+ * @file alternativeroutes.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Precomputed alternative routes between stations
+ */
+
+#include "alternativeroutes.h"
+
+AlternativeRoutes::AlternativeRoutes() {}
+
+
+bool AlternativeRoutes::build(const Pathfinding& graph, const QVector<std::pair<std::tuple<int,int>, std::tuple<int,int>>>& legs, int k,
+                              const std::atomic<bool> *cancelled)
+{
+    struct Job {
+        std::tuple<int,int> start;
+        std::tuple<int,int> end;
+        QVector<Route> routes;
+    };
+    // routes are stored only when all jobs finished, a cancelled build leaves no empty legs behind
+    QVector<Job> jobs;
+    QMap<std::tuple<int,int,int,int>, int> queued;  ///< Indexes of jobs
+    for (const auto& leg : legs)
+    {
+        auto key = std::tuple_cat(leg.first, leg.second);
+        if (leg.first == leg.second or this->legs.contains(key) or queued.contains(key)) continue;
+
+        queued.insert(key, jobs.size());
+        jobs.push_back(Job {leg.first, leg.second, QVector<Route>()});
+    }
+
+    QtConcurrent::blockingMap(jobs, [&graph, k, cancelled](Job& job) {
+        if (cancelled and cancelled->load()) return;
+
+        thread_local Pathfinding::Workspace workspace;
+        const auto& edges = graph.getEdges();
+        QVector<float> factors(edges.size(), 1.0f);
+
+        graph.loadGoal(job.start, job.end, workspace);
+        for (int attempt = 0; attempt < 2*k and job.routes.size() < k; ++attempt)
+        {
+            graph.solveAStar(factors, workspace);
+            auto route = graph.getSolutionEdges(workspace);
+            if (route.isEmpty()) break;
+
+            float length = 0.0f;
+            for (const auto e : route)
+                length += edges[e].length;
+            if (!job.routes.isEmpty() and length > stretch * job.routes.first().length) break;
+
+            // the same route is found again when penalties did not outweigh any detour yet
+            auto known = std::any_of(job.routes.begin(), job.routes.end(), [&route](const Route& r) {return r.edges == route;});
+            if (!known)
+            {
+                job.routes.push_back(Route {graph.getSolution(workspace), route, length});
+            }
+
+            for (const auto e : route)
+                factors[e] *= penalty;
+        }
+
+        std::stable_sort(job.routes.begin(), job.routes.end(), [](const Route& a, const Route& b) {return a.length < b.length;});
+    });
+
+    if (cancelled and cancelled->load()) return false;
+
+    for (const auto& job : jobs)
+    {
+        this->legs[std::tuple_cat(job.start, job.end)] = job.routes;
+    }
+    return true;
+}
+
+
+void AlternativeRoutes::insert(std::tuple<int,int> start, std::tuple<int,int> end, const QVector<Route>& routes)
+{
+    legs.insert(std::tuple_cat(start, end), routes);
+}
+
+
+const QMap<std::tuple<int,int,int,int>, QVector<AlternativeRoutes::Route>>& AlternativeRoutes::getLegs() const
+{
+    return legs;
+}
+
+
+void AlternativeRoutes::clear()
+{
+    legs.clear();
+}
+
+
+const AlternativeRoutes::Route* AlternativeRoutes::find(const Pathfinding& graph, std::tuple<int,int> start, std::tuple<int,int> end) const
+{
+    auto it = legs.find(std::tuple_cat(start, end));
+    if (it == legs.end()) return nullptr;
+
+    const auto& edges = graph.getEdges();
+    for (const auto& route : *it)
+    {
+        auto open = std::none_of(route.edges.begin(), route.edges.end(), [&edges](int e) {return edges[e].closed;});
+        if (open) return &route;
+    }
+    return nullptr;
+}
+
+
+int AlternativeRoutes::size() const
+{
+    return legs.size();
+}
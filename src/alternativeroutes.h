@@ -0,0 +1,102 @@
+/*!
+ * @file alternativeroutes.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of precomputed alternative routes between stations
+ */
+
+#ifndef ALTERNATIVEROUTES_H
+#define ALTERNATIVEROUTES_H
+
+#include <QVector>
+#include <QMap>
+#include <QtConcurrent>
+#include <tuple>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include "pathfinding.h"
+
+/*!
+ * \brief Diverse routes of legs of lines (routes between two following stations) computed when a map is loaded
+ * \details Routes are found by the penalty method, edges of every found route get longer and the search runs again,
+ * so following routes avoid them where a detour is not much longer. Routes longer than the allowed stretch
+ * of the shortest route are dropped. After streets are closed, the shortest route without a closed edge
+ * is picked by checking edge sets of routes, no search is needed unless all routes of the leg are closed.
+ * Routes are valid only for lengths of streets, they are not used while traffic factors are applied.
+ */
+class AlternativeRoutes
+{
+public:
+    /*!
+     * \brief The Route structure
+     */
+    struct Route {
+        QVector<std::tuple<int,int>> points;    ///< Points of the route including both stations
+        QVector<int> edges;                     ///< Indexes of edges of the graph in the order of the route
+        float length;
+    };
+
+    /*!
+     * \brief constructor
+     */
+    AlternativeRoutes();
+
+    /*!
+     * \brief computes alternative routes of legs on the global thread pool
+     * \details has to be called with all streets open
+     * \param graph graph with loaded points and paths
+     * \param legs coordinates of the first and the second station of every leg
+     * \param k maximal number of routes of one leg
+     * \param cancelled legs not started yet are skipped once the flag is set (may be nullptr)
+     * \return false if building was cancelled, routes are incomplete then
+     */
+    bool build(const Pathfinding& graph, const QVector<std::pair<std::tuple<int,int>, std::tuple<int,int>>>& legs, int k = 3,
+               const std::atomic<bool> *cancelled = nullptr);
+
+    /*!
+     * \brief stores routes of the leg computed before (read from a route cache file)
+     * \param start coordinates of the first station
+     * \param end coordinates of the second station
+     * \param routes routes sorted by length
+     */
+    void insert(std::tuple<int,int> start, std::tuple<int,int> end, const QVector<Route>& routes);
+
+    /*!
+     * \brief returns routes of all legs
+     * \return routes sorted by length (key is coordinates of both stations)
+     */
+    const QMap<std::tuple<int,int,int,int>, QVector<Route>>& getLegs() const;
+
+    /*!
+     * \brief removes all routes
+     */
+    void clear();
+
+    /*!
+     * \brief returns the shortest route of the leg without any closed edge
+     * \details does not modify routes, can run concurrently with other queries
+     * \param graph graph the routes were built from, with current closures
+     * \param start coordinates of the first station
+     * \param end coordinates of the second station
+     * \return pointer to the route or nullptr if the leg is unknown or all its routes are closed
+     */
+    const Route* find(const Pathfinding& graph, std::tuple<int,int> start, std::tuple<int,int> end) const;
+
+    /*!
+     * \brief returns number of legs with routes
+     * \return
+     */
+    int size() const;
+
+private:
+    typedef std::tuple<int,int,int,int> LegKey;
+
+    static constexpr float penalty = 1.5f;  ///< Factor applied to edges of a found route
+    static constexpr float stretch = 1.5f;  ///< Longest allowed route relative to the shortest one
+
+    QMap<LegKey, QVector<Route>> legs;      ///< Routes sorted by length (key is coordinates of both stations)
+};
+
+#endif // ALTERNATIVEROUTES_H
@@ -0,0 +1,120 @@
+/*!
+ * @file commandqueue.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Lock-free multiple-producer single-consumer queue
+ */
+
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <QVector>
+#include <atomic>
+#include <utility>
+
+/*!
+ * \brief Lock-free queue of values posted by any number of threads and taken by one consumer thread
+ * \details Producers push onto a linked stack by a single compare-and-swap, the consumer takes the whole stack
+ * by one exchange and reverses it, so values come out in the order they were posted. A batch of values is linked
+ * before it is pushed and costs a single compare-and-swap too. Taking everything at once avoids the ABA problem.
+ */
+template<typename T>
+class CommandQueue
+{
+public:
+    CommandQueue() = default;
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    ~CommandQueue()
+    {
+        auto node = head.load(std::memory_order_acquire);
+        while (node)
+        {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    /*!
+     * \brief posts one value
+     * \param value
+     * \return true if the queue was empty, so the consumer may need to be woken up
+     */
+    bool post(T value)
+    {
+        auto node = new Node {std::move(value), nullptr};
+        return push(node, node);
+    }
+
+    /*!
+     * \brief posts values in their order by a single compare-and-swap
+     * \param values
+     * \return true if the queue was empty, so the consumer may need to be woken up
+     */
+    bool post(const QVector<T>& values)
+    {
+        if (values.isEmpty()) return false;
+
+        // the stack holds the newest value first
+        Node *first = nullptr;
+        Node *last = nullptr;
+        for (const auto& value : values)
+        {
+            first = new Node {value, first};
+            if (!last) last = first;
+        }
+        return push(first, last);
+    }
+
+    /*!
+     * \brief takes all posted values, called only by the consumer
+     * \return values in the order they were posted
+     */
+    QVector<T> take()
+    {
+        auto node = head.exchange(nullptr, std::memory_order_acquire);
+
+        Node *reversed = nullptr;
+        int count = 0;
+        while (node)
+        {
+            auto next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+            ++count;
+        }
+
+        QVector<T> values;
+        values.reserve(count);
+        while (reversed)
+        {
+            auto next = reversed->next;
+            values.push_back(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+        }
+        return values;
+    }
+
+private:
+    struct Node {
+        T value;
+        Node *next;
+    };
+
+    std::atomic<Node*> head {nullptr};  ///< Newest posted value
+
+    bool push(Node *first, Node *last)
+    {
+        auto old = head.load(std::memory_order_relaxed);
+        do {
+            last->next = old;
+        } while (!head.compare_exchange_weak(old, first, std::memory_order_release, std::memory_order_relaxed));
+        return old == nullptr;
+    }
+};
+
+#endif // COMMANDQUEUE_H
@@ -0,0 +1,445 @@
+/*!
+ * @file contractionhierarchy.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Fast routing over the contracted street graph
+ */
+
+#include "contractionhierarchy.h"
+
+ContractionHierarchy::ContractionHierarchy() {}
+
+
+void ContractionHierarchy::build(const Pathfinding& graph)
+{
+    const auto& nodes = graph.getGraph();
+
+    coords.clear();
+    index.clear();
+    order.clear();
+    edges = graph.getEdges();
+    streetEdges = graph.getStreetEdges();
+
+    for (const auto& node : nodes)
+    {
+        auto point = std::tuple<int,int>(node.x, node.y);
+        index.insert(point, coords.size());
+        coords.push_back(point);
+    }
+
+    const int n = coords.size();
+
+    // remaining graph of the elimination, value are original edges between the nodes (empty for fill-in)
+    QVector<QMap<int,QVector<int>>> remaining(n);
+    for (int e = 0; e < edges.size(); ++e)
+    {
+        const auto& edge = edges[e];
+        if (edge.from == edge.to) continue;
+
+        remaining[edge.from][edge.to].push_back(e);
+    }
+
+    // contract nodes with the lowest degree first, neighbours of a contracted node are connected by shortcuts
+    rank.fill(-1, n);
+    up = QVector<QVector<Arc>>(n);
+
+    using Entry = std::pair<int,int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int i = 0; i < n; ++i)
+        queue.push(Entry(remaining[i].size(), i));
+
+    while (!queue.empty())
+    {
+        auto degree = queue.top().first;
+        auto v = queue.top().second;
+        queue.pop();
+
+        if (rank[v] != -1 or degree != remaining[v].size()) continue;
+
+        rank[v] = order.size();
+        order.push_back(v);
+
+        const auto neighbours = remaining[v].keys();
+        for (const auto a : neighbours)
+        {
+            up[v].push_back(Arc {a, remaining[v][a], INFINITY, -1, -1});
+            remaining[a].remove(v);
+        }
+
+        for (int i = 0; i < neighbours.size(); ++i)
+        {
+            for (int j = i + 1; j < neighbours.size(); ++j)
+            {
+                auto a = neighbours[i];
+                auto b = neighbours[j];
+                if (!remaining[a].contains(b)) {
+                    remaining[a].insert(b, QVector<int>());
+                    remaining[b].insert(a, QVector<int>());
+                }
+            }
+        }
+
+        for (const auto a : neighbours)
+            queue.push(Entry(remaining[a].size(), a));
+
+        remaining[v].clear();
+    }
+
+    workspace = Workspace();
+
+    customize();
+}
+
+
+void ContractionHierarchy::customize()
+{
+    for (int v = 0; v < up.size(); ++v)
+    {
+        for (auto& arc : up[v])
+        {
+            arc.weight = INFINITY;
+            arc.middle = -1;
+            arc.edge = -1;
+
+            // parallel edges (different streets between the same nodes) are represented by the cheapest open one
+            for (const auto e : arc.edges)
+            {
+                const auto& edge = edges[e];
+                if (edge.closed or edge.length * edge.cost >= arc.weight) continue;
+
+                arc.weight = edge.length * edge.cost;
+                arc.edge = e;
+            }
+        }
+    }
+
+    // lower triangles are relaxed bottom-up, so upward arcs of a node are final before the node is processed
+    for (const auto v : order)
+    {
+        const auto& arcs = up[v];
+        for (int i = 0; i < arcs.size(); ++i)
+        {
+            for (int j = 0; j < arcs.size(); ++j)
+            {
+                auto a = arcs[i].head;
+                auto b = arcs[j].head;
+                if (rank[a] >= rank[b]) continue;
+
+                auto weight = arcs[i].weight + arcs[j].weight;
+                auto arc = findArc(a, b);
+                if (arc and weight < arc->weight) {
+                    arc->weight = weight;
+                    arc->middle = v;
+                }
+            }
+        }
+    }
+
+    customized = true;
+}
+
+
+void ContractionHierarchy::refresh()
+{
+    if (!customized) customize();
+}
+
+
+bool ContractionHierarchy::isBuilt() const
+{
+    return !up.isEmpty();
+}
+
+
+bool ContractionHierarchy::setStreetClosed(const QString& name, bool closed)
+{
+    auto it = streetEdges.find(name);
+    if (it == streetEdges.end()) return false;
+
+    for (const auto e : *it)
+    {
+        if (edges[e].closed != closed) {
+            edges[e].closed = closed;
+            customized = false;
+        }
+    }
+    return true;
+}
+
+
+bool ContractionHierarchy::setStreetCost(const QString& name, float cost)
+{
+    auto it = streetEdges.find(name);
+    if (it == streetEdges.end()) return false;
+
+    for (const auto e : *it)
+    {
+        if (edges[e].cost != cost) {
+            edges[e].cost = cost;
+            customized = false;
+        }
+    }
+    return true;
+}
+
+
+void ContractionHierarchy::loadGoal(std::tuple<int,int> start, std::tuple<int,int> end)
+{
+    loadGoal(start, end, workspace);
+}
+
+
+void ContractionHierarchy::loadGoal(std::tuple<int,int> start, std::tuple<int,int> end, Workspace& workspace) const
+{
+    workspace.nodeStart = index.value(start, -1);
+    workspace.nodeEnd = index.value(end, -1);
+}
+
+
+bool ContractionHierarchy::solve()
+{
+    refresh();
+    return solve(workspace);
+}
+
+
+bool ContractionHierarchy::solve(Workspace& workspace) const
+{
+    auto& solution = workspace.solution;
+    auto& distForward = workspace.distForward;
+    auto& distBackward = workspace.distBackward;
+    auto& parentForward = workspace.parentForward;
+    auto& parentBackward = workspace.parentBackward;
+    auto& touched = workspace.touched;
+
+    solution.clear();
+    workspace.edges.clear();
+    if (!isBuilt() or !customized or workspace.nodeStart < 0 or workspace.nodeEnd < 0) return false;
+
+    if (distForward.size() != coords.size())
+    {
+        distForward.fill(INFINITY, coords.size());
+        distBackward.fill(INFINITY, coords.size());
+        parentForward.fill(-1, coords.size());
+        parentBackward.fill(-1, coords.size());
+        touched.clear();
+    }
+
+    for (const auto v : touched)
+    {
+        distForward[v] = INFINITY;
+        distBackward[v] = INFINITY;
+        parentForward[v] = -1;
+        parentBackward[v] = -1;
+    }
+    touched.clear();
+
+    searchUpward(workspace.nodeStart, distForward, parentForward, touched, workspace.heap);
+    searchUpward(workspace.nodeEnd, distBackward, parentBackward, touched, workspace.heap);
+
+    int meet = -1;
+    float best = INFINITY;
+    for (const auto v : touched)
+    {
+        if (distForward[v] + distBackward[v] < best) {
+            best = distForward[v] + distBackward[v];
+            meet = v;
+        }
+    }
+
+    if (meet < 0) {
+        solution.push_back(coords[workspace.nodeEnd]);
+        return false;
+    }
+
+    auto& upwardPath = workspace.upwardPath;
+    upwardPath.clear();
+    for (int v = meet; v != -1; v = parentForward[v])
+        upwardPath.push_back(v);
+    std::reverse(upwardPath.begin(), upwardPath.end());
+    for (int v = parentBackward[meet]; v != -1; v = parentBackward[v])
+        upwardPath.push_back(v);
+
+    solution.push_back(coords[upwardPath.first()]);
+    for (int i = 1; i < upwardPath.size(); ++i)
+        unpack(upwardPath[i-1], upwardPath[i], workspace);
+
+    return true;
+}
+
+
+QVector<std::tuple<int,int>> ContractionHierarchy::getSolution()
+{
+    return getSolution(workspace);
+}
+
+
+QVector<std::tuple<int,int>> ContractionHierarchy::getSolution(const Workspace& workspace) const
+{
+    return workspace.solution;
+}
+
+
+QVector<int> ContractionHierarchy::getSolutionEdges(const Workspace& workspace) const
+{
+    return workspace.edges;
+}
+
+
+QVector<float> ContractionHierarchy::distanceMatrix(const QVector<std::tuple<int,int>>& sources, const QVector<std::tuple<int,int>>& targets)
+{
+    const int rows = sources.size();
+    const int columns = targets.size();
+    QVector<float> matrix(rows * columns, INFINITY);
+    if (!isBuilt() or rows == 0 or columns == 0) return matrix;
+
+    refresh();
+
+    const int n = coords.size();
+    const int chunks = std::max(1, std::min(std::max(rows, columns), QThread::idealThreadCount()));
+    QVector<int> chunkIds;
+    for (int i = 0; i < chunks; ++i)
+        chunkIds.push_back(i);
+
+    // upward search spaces of targets (node, distance)
+    QVector<QVector<std::pair<int,float>>> spaces(columns);
+    auto spacesData = spaces.data();
+    QtConcurrent::blockingMap(chunkIds, [&](int& chunk) {
+        QVector<float> dist(n, INFINITY);
+        QVector<int> parent(n, -1);
+        QVector<int> reached;
+        QVector<std::pair<float,int>> heap;
+
+        for (int column = columns * chunk / chunks; column < columns * (chunk + 1) / chunks; ++column)
+        {
+            auto t = index.value(targets[column], -1);
+            if (t < 0) continue;
+
+            searchUpward(t, dist, parent, reached, heap);
+            for (const auto v : reached)
+            {
+                if (dist[v] == INFINITY) continue;
+                spacesData[column].push_back(std::pair<int,float>(v, dist[v]));
+                dist[v] = INFINITY;
+                parent[v] = -1;
+            }
+            reached.clear();
+        }
+    });
+
+    QVector<QVector<std::pair<int,float>>> buckets(n);
+    for (int column = 0; column < columns; ++column)
+    {
+        for (const auto& entry : spaces[column])
+            buckets[entry.first].push_back(std::pair<int,float>(column, entry.second));
+    }
+    spaces.clear();
+
+    // upward searches of sources meet targets in buckets, every chunk writes only its own rows
+    const auto& constBuckets = buckets;
+    auto cells = matrix.data();
+    QtConcurrent::blockingMap(chunkIds, [&](int& chunk) {
+        QVector<float> dist(n, INFINITY);
+        QVector<int> parent(n, -1);
+        QVector<int> reached;
+        QVector<std::pair<float,int>> heap;
+
+        for (int row = rows * chunk / chunks; row < rows * (chunk + 1) / chunks; ++row)
+        {
+            auto s = index.value(sources[row], -1);
+            if (s < 0) continue;
+
+            searchUpward(s, dist, parent, reached, heap);
+            for (const auto v : reached)
+            {
+                if (dist[v] == INFINITY) continue;
+                for (const auto& entry : constBuckets[v])
+                {
+                    auto& cell = cells[row * columns + entry.first];
+                    cell = std::min(cell, dist[v] + entry.second);
+                }
+                dist[v] = INFINITY;
+                parent[v] = -1;
+            }
+            reached.clear();
+        }
+    });
+
+    return matrix;
+}
+
+
+const ContractionHierarchy::Arc* ContractionHierarchy::findArc(int a, int b) const
+{
+    if (rank[a] > rank[b]) std::swap(a, b);
+
+    const auto& arcs = up[a];
+    auto it = std::lower_bound(arcs.begin(), arcs.end(), b, [](const Arc& arc, int head) {return arc.head < head;});
+    if (it == arcs.end() or it->head != b) return nullptr;
+    return &*it;
+}
+
+
+ContractionHierarchy::Arc* ContractionHierarchy::findArc(int a, int b)
+{
+    return const_cast<Arc*>(static_cast<const ContractionHierarchy*>(this)->findArc(a, b));
+}
+
+
+void ContractionHierarchy::searchUpward(int source, QVector<float>& dist, QVector<int>& parent, QVector<int>& reached, QVector<std::pair<float,int>>& heap) const
+{
+    using Entry = std::pair<float,int>;
+    heap.clear();
+
+    dist[source] = 0.0f;
+    reached.push_back(source);
+    heap.push_back(Entry(0.0f, source));
+
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        auto d = heap.last().first;
+        auto v = heap.last().second;
+        heap.pop_back();
+
+        if (d > dist[v]) continue;
+
+        for (const auto& arc : up[v])
+        {
+            auto possiblyLowerGoal = d + arc.weight;
+            if (possiblyLowerGoal < dist[arc.head])
+            {
+                reached.push_back(arc.head);
+                dist[arc.head] = possiblyLowerGoal;
+                parent[arc.head] = v;
+                heap.push_back(Entry(possiblyLowerGoal, arc.head));
+                std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+            }
+        }
+    }
+}
+
+
+void ContractionHierarchy::unpack(int from, int to, Workspace& workspace) const
+{
+    auto& result = workspace.solution;
+    auto arc = findArc(from, to);
+    if (!arc or arc->middle == -1) {
+        if (arc and arc->edge != -1) {
+            workspace.edges.push_back(arc->edge);
+            // edges of the arc lead from its lower ranked node
+            const auto& polyline = edges[arc->edge].polyline;
+            if (edges[arc->edge].from == from) {
+                for (int i = 0; i < polyline.size(); ++i)
+                    result.push_back(polyline[i]);
+            } else {
+                for (int i = polyline.size() - 1; i >= 0; --i)
+                    result.push_back(polyline[i]);
+            }
+        }
+        result.push_back(coords[to]);
+        return;
+    }
+    unpack(from, arc->middle, workspace);
+    unpack(arc->middle, to, workspace);
+}
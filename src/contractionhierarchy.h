@@ -0,0 +1,210 @@
+/*!
+ * @file contractionhierarchy.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the contraction hierarchy used for fast routing
+ */
+
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include <QVector>
+#include <QMap>
+#include <QSet>
+#include <QThread>
+#include <QtConcurrent>
+#include <tuple>
+#include <cmath>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "pathfinding.h"
+
+/*!
+ * \brief Customizable contraction hierarchy built over the pathfinding graph
+ * \details Nodes of the graph created by Pathfinding::loadPaths() are contracted in a metric independent
+ * (minimum degree) order, every contracted node connects all of its remaining neighbours by shortcuts.
+ * Edge weights are applied afterwards by customize(), so closed streets only require
+ * a cheap re-customization instead of a new contraction. Queries are bidirectional upward Dijkstra searches.
+ * Nodes and edges are the same as in the pathfinding graph, polylines of edges are expanded when unpacking a route.
+ */
+class ContractionHierarchy
+{
+public:
+    /*!
+     * \brief The Workspace structure
+     * \details Search state of one query, every thread running queries uses its own workspace.
+     * Buffers keep their capacity between queries, so repeated queries do not allocate.
+     */
+    struct Workspace {
+        int nodeStart = -1;
+        int nodeEnd = -1;
+        QVector<float> distForward;         ///< Search state, reset only for touched nodes
+        QVector<float> distBackward;
+        QVector<int> parentForward;
+        QVector<int> parentBackward;
+        QVector<int> touched;
+        QVector<std::pair<float,int>> heap; ///< Priority queue of upward searches
+        QVector<int> upwardPath;            ///< Route in the hierarchy before unpacking shortcuts
+        QVector<std::tuple<int,int>> solution;
+        QVector<int> edges;                 ///< Original edges of the solution in the order of the route
+    };
+
+    /*!
+     * \brief constructor
+     */
+    ContractionHierarchy();
+
+    /*!
+     * \brief contracts the graph
+     * \details takes nodes, edges, traffic factors and closures from the given pathfinding graph, computes
+     * the contraction order and customizes the hierarchy
+     * \param graph graph with loaded points and paths
+     */
+    void build(const Pathfinding& graph);
+
+    /*!
+     * \brief recomputes weights of all shortcuts from the current edge weights and closures
+     */
+    void customize();
+
+    /*!
+     * \brief customizes the hierarchy if closures or traffic factors changed since the last customization
+     * \details has to be called before concurrent queries, those do not modify the hierarchy
+     */
+    void refresh();
+
+    /*!
+     * \brief returns true if the hierarchy was built and can answer queries
+     * \return
+     */
+    bool isBuilt() const;
+
+    /*!
+     * \brief closes/opens the street
+     * \details the hierarchy is re-customized lazily before the next query
+     * \param name name of the street
+     * \param closed true if the street is blocked
+     * \return true if succeeds, otherwise false
+     */
+    bool setStreetClosed(const QString& name, bool closed);
+
+    /*!
+     * \brief sets traffic factor of the street
+     * \details same semantics as Pathfinding::setStreetCost(), the hierarchy is re-customized lazily before the next query
+     * \param name name of the street
+     * \param cost traffic factor (1 is free flow)
+     * \return true if succeeds, otherwise false
+     */
+    bool setStreetCost(const QString& name, float cost);
+
+    /*!
+     * \brief loads a goal
+     * \details loads a goal (start & end points) for a query
+     * \param start node coordinates
+     * \param end node coordinates
+     */
+    void loadGoal(std::tuple<int,int> start, std::tuple<int,int> end);
+
+    /*!
+     * \brief loads a goal into the given workspace
+     * \param start node coordinates
+     * \param end node coordinates
+     * \param workspace
+     */
+    void loadGoal(std::tuple<int,int> start, std::tuple<int,int> end, Workspace& workspace) const;
+
+    /*!
+     * \brief finds the route between start & end points
+     * \return true if the hierarchy is built and the end is reachable, otherwise false
+     */
+    bool solve();
+
+    /*!
+     * \brief finds the route between start & end points loaded in the workspace
+     * \details the hierarchy has to be customized by refresh() first
+     * \param workspace
+     * \return true if the hierarchy is customized and the end is reachable, otherwise false
+     */
+    bool solve(Workspace& workspace) const;
+
+    /*!
+     * \brief returns the solution calculated by solve() method
+     * \details if the end is not reachable, only the end node is returned (same as Pathfinding::getSolution())
+     * \return
+     */
+    QVector<std::tuple<int,int>> getSolution();
+
+    /*!
+     * \brief returns the solution stored in the workspace
+     * \details the returned vector shares the buffer of the workspace, it should be released before the next query
+     * to let the workspace reuse the buffer
+     * \param workspace
+     * \return
+     */
+    QVector<std::tuple<int,int>> getSolution(const Workspace& workspace) const;
+
+    /*!
+     * \brief returns edges of the solution stored in the workspace
+     * \details edges are indexes into edges of the pathfinding graph, either direction of a chain may be returned
+     * \param workspace
+     * \return empty if the end was not reached
+     */
+    QVector<int> getSolutionEdges(const Workspace& workspace) const;
+
+    /*!
+     * \brief computes distances between all sources and all targets in one batch
+     * \details bucket based many-to-many search, upward searches from targets fill buckets in the hierarchy,
+     * upward searches from sources scan them, both phases run in parallel on the global thread pool
+     * \param sources coordinates of source nodes
+     * \param targets coordinates of target nodes
+     * \return row-major matrix (sources x targets) of distances, INFINITY if the target is not reachable
+     */
+    QVector<float> distanceMatrix(const QVector<std::tuple<int,int>>& sources, const QVector<std::tuple<int,int>>& targets);
+
+private:
+    /*!
+     * \brief The Arc structure
+     * \details Upward arc from a lower ranked node to a higher ranked node.
+     */
+    struct Arc {
+        int head;               ///< Index of the higher ranked node
+        QVector<int> edges;     ///< Original edges leading from the lower ranked node to the head (empty for shortcuts)
+        float weight;           ///< Customized weight (length multiplied by the traffic factor)
+        int middle = -1;        ///< Lower ranked node the arc goes through (-1 for an original edge)
+        int edge = -1;          ///< Cheapest open original edge (-1 if there is none)
+    };
+
+    QVector<std::tuple<int,int>> coords;            ///< Coordinates of nodes (index is the node id)
+    QMap<std::tuple<int,int>, int> index;           ///< Node ids (key is nodes coordinates)
+    QVector<Pathfinding::Edge> edges;               ///< Copy of edges of the graph with their closures and traffic factors
+    QMap<QString, QVector<int>> streetEdges;
+    QVector<int> rank;                              ///< Position of the node in the contraction order
+    QVector<int> order;                             ///< Nodes sorted by rank
+    QVector<QVector<Arc>> up;                       ///< Upward arcs of each node, sorted by head
+    bool customized = false;
+
+    Workspace workspace;                            ///< Workspace used by queries without an explicit workspace
+
+    /*!
+     * \brief returns the upward arc between two nodes
+     * \return pointer to the arc or nullptr if nodes are not connected
+     */
+    const Arc* findArc(int a, int b) const;
+    Arc* findArc(int a, int b);
+
+    /*!
+     * \brief runs an upward Dijkstra search from the source node
+     * \param heap storage of the priority queue, reused between searches
+     */
+    void searchUpward(int source, QVector<float>& dist, QVector<int>& parent, QVector<int>& reached, QVector<std::pair<float,int>>& heap) const;
+
+    /*!
+     * \brief appends unpacked original points (without the first node) and edges of the arc to the solution
+     */
+    void unpack(int from, int to, Workspace& workspace) const;
+};
+
+#endif // CONTRACTIONHIERARCHY_H
@@ -19,6 +19,8 @@
 #include <QMetaType>
 #include <QPushButton>
 #include <tuple>
+#include <cmath>
+#include <algorithm>
 
 /*!
  * \brief The bus struct
@@ -32,7 +34,7 @@ struct bus{
     double d;               ///< Used for a movement calculation
     bool reversed = false;  ///< True if bus is going back to start station
     bool halt = false;      ///< If the calculated route is not correct, halt (stop) all buses on the line
-    int slow = 1;           ///< Higher the number, slower the bus moves
+    float slow = 1;         ///< Higher the number, slower the bus moves
     int wait = 0;
     int initWait = 0;
     QString startStation;
@@ -61,9 +63,77 @@ struct line{
     QString endOriginal;
     QVector<std::tuple<int,int,int,int>> pathLines;
     QGraphicsItemGroup * renderedPath = nullptr;
+    int fleet = 10;             ///< Number of buses created from every bus entry of the line
+    int headway = 10000;        ///< Milliseconds between departures of buses created from one bus entry
+    int layover = 3000;         ///< Milliseconds a bus waits after arriving into the end station
+    QVector<int> timetable;     ///< Departure times (milliseconds of the day), replaces the fleet and headway if not empty, dispatched once per line
 };
 Q_DECLARE_METATYPE(line);
 
+/*!
+ * \brief The TrafficProfile class
+ * \details Traffic factor of a street during the day, linearly interpolated between given times, repeats every 24 hours.
+ */
+class TrafficProfile
+{
+private:
+    QVector<std::tuple<int,float>> points;  ///< Time of the day in seconds and traffic factor, sorted by time
+public:
+    /*!
+     * \brief TrafficProfile::add()
+     * \param second time of the day in seconds
+     * \param factor traffic factor at the given time
+     */
+    void add(int second, float factor) {
+        auto it = std::upper_bound(points.begin(), points.end(), second,
+                                   [](int s, const std::tuple<int,float>& point) {return s < std::get<0>(point);});
+        points.insert(it, std::tuple<int,float>(second, factor));
+    }
+
+    /*!
+     * \brief TrafficProfile::isEmpty()
+     * \return true if the profile has no points
+     */
+    bool isEmpty() const {
+        return points.isEmpty();
+    }
+
+    /*!
+     * \brief TrafficProfile::at()
+     * \param second time of the day in seconds
+     * \return interpolated traffic factor, 1 if the profile is empty
+     */
+    float at(double second) const {
+        if (points.isEmpty()) return 1.0f;
+
+        second = fmod(second, 86400.0);
+        if (second < 0) second += 86400.0;
+
+        auto it = std::upper_bound(points.begin(), points.end(), second,
+                                   [](double s, const std::tuple<int,float>& point) {return s < std::get<0>(point);});
+
+        double t0, t1;
+        float f0, f1;
+        if (it == points.begin()) {
+            t0 = std::get<0>(points.last()) - 86400.0;
+            f0 = std::get<1>(points.last());
+        } else {
+            t0 = std::get<0>(*(it - 1));
+            f0 = std::get<1>(*(it - 1));
+        }
+        if (it == points.end()) {
+            t1 = std::get<0>(points.first()) + 86400.0;
+            f1 = std::get<1>(points.first());
+        } else {
+            t1 = std::get<0>(*it);
+            f1 = std::get<1>(*it);
+        }
+
+        if (t1 <= t0) return f0;
+        return float(f0 + (f1 - f0) * (second - t0) / (t1 - t0));
+    }
+};
+
 /*!
  * \brief The street struct
  * \details Stores all information about a certain street.
@@ -71,8 +141,9 @@ Q_DECLARE_METATYPE(line);
 struct street{
     QString name;
     int traffic = 1;        ///< Controls how fast is trafic on the street (higher the number, the slower buses on the street are)
+    TrafficProfile profile; ///< Changes of the traffic during the day, multiplies "traffic"
+    float profileFactor = 1.0f; ///< Value of the profile at the current time of the simulation
     bool isBlocked = false;
-    QVector<std::tuple<int,int>> mid;
     QVector<std::tuple<int,int,int,int>> pathLines;
     QGraphicsItemGroup * renderedPath = nullptr;
 };
@@ -95,28 +166,50 @@ Q_DECLARE_METATYPE(stop);
  * \details Used to connect rendered item and data structures.
  */
 struct container{
-    QString type = "";
+    enum Type {
+        None,
+        Street,     ///< stringKey is the name of the street
+        Stop,       ///< stringKey is the name of the stop
+        Line,       ///< intKey is the number of the line
+        Bus         ///< intKey is the index of the bus
+    };
+
+    Type type = None;
     QString stringKey = "";
     int intKey = 0;
+    QGraphicsItem * item = nullptr;
 };
 Q_DECLARE_METATYPE(container);
 
 /*!
- * \brief The KeyGen class
- * \details Simple class for generating integer keys.
+ * \brief The command struct
+ * \details Operator action posted to the simulation, applied between two ticks.
  */
-class KeyGen
-{
-private:
-    int generatedKey = INT_MIN;
-public:
-    /*!
-     * \brief KeyGen::gen()
-     * \return
-     */
-    int gen() {
-        return generatedKey++;
-    }
+struct command{
+    enum Type {
+        Reset,              ///< Resets time, vehicles and routes
+        Step,               ///< Runs one tick
+        Skip,               ///< Moves forward by "value" milliseconds
+        Rewind,             ///< Moves back by "value" seconds
+        SetSpeed,           ///< Sets speed to "value"
+        SetTraffic,         ///< Sets traffic of the "street" to "value"
+        SetTrafficRouting,  ///< Turns routing by traffic on (value 1) or off (value 0)
+        BlockStreet,        ///< Closes the "street"
+        UnblockStreet,      ///< Opens the "street"
+        EditLine,           ///< Changes the route of the line "value" to "stations"
+        ResetLines          ///< Restores original routes of all lines
+    };
+
+    command(Type type = Reset) : type(type) {}
+
+    Type type;
+    int value = 0;
+    QString street;
+    QVector<QString> stations;  ///< Start station, stops and end station
+    int at = -1;                ///< Time of the day (milliseconds) the command is applied at, -1 for the next tick
+    qint64 sequence = 0;        ///< Order of posting, orders commands applied at the same time
+    int appliedAt = -1;         ///< Time of the day (milliseconds) the command was applied at
 };
+Q_DECLARE_METATYPE(command);
 
 #endif // DATASTRUCTURES_H
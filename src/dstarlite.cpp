@@ -0,0 +1,226 @@
+/*!
+ * @file dstarlite.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Incremental replanning by D* Lite
+ */
+
+#include "dstarlite.h"
+
+DStarLite::DStarLite() {}
+
+
+DStarLite::DStarLite(const Pathfinding& graph, std::tuple<int,int> goal) : graph(&graph)
+{
+    const auto& nodes = graph.getGraph();
+    const auto& edges = graph.getEdges();
+
+    g.fill(INFINITY, nodes.size());
+    rhs.fill(INFINITY, nodes.size());
+    queued.fill(Key(INFINITY, INFINITY), nodes.size());
+    open.fill(false, nodes.size());
+    incoming.resize(nodes.size());
+    for (int e = 0; e < edges.size(); ++e)
+        incoming[edges[e].to].push_back(e);
+
+    this->goal = graph.findNode(goal);
+    if (this->goal == -1) return;
+
+    rhs[this->goal] = 0.0f;
+    updateVertex(this->goal);
+}
+
+
+float DStarLite::weight(int edge) const
+{
+    const auto& e = graph->getEdges()[edge];
+    return e.closed ? INFINITY : e.length * e.cost;
+}
+
+
+float DStarLite::heuristic(int node) const
+{
+    if (start == -1) return 0.0f;
+
+    const auto& a = graph->getGraph()[start];
+    const auto& b = graph->getGraph()[node];
+    return sqrtf(powf(a.x - b.x, 2) + powf(a.y - b.y, 2));
+}
+
+
+DStarLite::Key DStarLite::calculateKey(int node) const
+{
+    auto best = std::min(g[node], rhs[node]);
+    return Key(best + heuristic(node) + km, best);
+}
+
+
+DStarLite::Key DStarLite::topKey()
+{
+    auto lowerKeyFirst = [](const Entry& lhs, const Entry& rhs) {return lhs.key > rhs.key;};
+
+    // entries of nodes which left the queue or got a new key are dropped lazily
+    while (!heap.isEmpty())
+    {
+        const auto& top = heap.first();
+        if (open[top.node] and queued[top.node] == top.key) return top.key;
+
+        std::pop_heap(heap.begin(), heap.end(), lowerKeyFirst);
+        heap.pop_back();
+    }
+    return Key(INFINITY, INFINITY);
+}
+
+
+void DStarLite::updateVertex(int node)
+{
+    const auto& edges = graph->getEdges();
+
+    if (node != goal)
+    {
+        float best = INFINITY;
+        for (const auto e : graph->getGraph()[node].edges)
+            best = std::min(best, weight(e) + g[edges[e].to]);
+        rhs[node] = best;
+    }
+
+    if (g[node] == rhs[node])
+    {
+        open[node] = false;
+        return;
+    }
+
+    auto key = calculateKey(node);
+    if (open[node] and queued[node] == key) return;
+
+    open[node] = true;
+    queued[node] = key;
+    heap.push_back(Entry {key, node});
+    std::push_heap(heap.begin(), heap.end(), [](const Entry& lhs, const Entry& rhs) {return lhs.key > rhs.key;});
+}
+
+
+void DStarLite::computeShortestPath()
+{
+    auto lowerKeyFirst = [](const Entry& lhs, const Entry& rhs) {return lhs.key > rhs.key;};
+    const auto& edges = graph->getEdges();
+
+    while (true)
+    {
+        auto top = topKey();
+        if (heap.isEmpty()) break;
+        if (!(top < calculateKey(start)) and rhs[start] == g[start]) break;
+
+        std::pop_heap(heap.begin(), heap.end(), lowerKeyFirst);
+        auto node = heap.last().node;
+        heap.pop_back();
+        open[node] = false;
+        ++expanded;
+
+        // the start moved since the key was computed, the node waits for its turn again
+        auto key = calculateKey(node);
+        if (top < key)
+        {
+            open[node] = true;
+            queued[node] = key;
+            heap.push_back(Entry {key, node});
+            std::push_heap(heap.begin(), heap.end(), lowerKeyFirst);
+        }
+        else if (g[node] > rhs[node])
+        {
+            g[node] = rhs[node];
+            for (const auto e : incoming[node])
+                updateVertex(edges[e].from);
+        }
+        else
+        {
+            g[node] = INFINITY;
+            updateVertex(node);
+            for (const auto e : incoming[node])
+                updateVertex(edges[e].from);
+        }
+    }
+}
+
+
+void DStarLite::updateEdges(const QVector<int>& changed)
+{
+    if (graph == nullptr or goal == -1) return;
+
+    const auto& edges = graph->getEdges();
+    for (const auto e : changed)
+        updateVertex(edges[e].from);
+}
+
+
+bool DStarLite::solve(std::tuple<int,int> start)
+{
+    expanded = 0;
+    if (graph == nullptr or goal == -1) return false;
+
+    auto node = graph->findNode(start);
+    if (node == -1)
+    {
+        this->start = -1;
+        return false;
+    }
+
+    // keys computed for the previous start stay lower bounds once the offset grows by the distance moved
+    if (this->start != -1) km += heuristic(node);
+    this->start = node;
+
+    computeShortestPath();
+    return g[node] != INFINITY;
+}
+
+
+float DStarLite::getCost() const
+{
+    return start == -1 ? INFINITY : g[start];
+}
+
+
+QVector<std::tuple<int,int>> DStarLite::getSolution() const
+{
+    QVector<std::tuple<int,int>> solution;
+    if (graph == nullptr or goal == -1) return solution;
+
+    const auto& nodes = graph->getGraph();
+    const auto& edges = graph->getEdges();
+    if (start == -1 or g[start] == INFINITY)
+    {
+        solution.push_back(std::tuple<int,int>(nodes[goal].x, nodes[goal].y));
+        return solution;
+    }
+
+    // follows the cheapest edge towards the goal, the step limit guards against cycles of equal distances
+    auto node = start;
+    solution.push_back(std::tuple<int,int>(nodes[node].x, nodes[node].y));
+    for (int steps = 0; node != goal and steps < nodes.size(); ++steps)
+    {
+        int next = -1;
+        float best = INFINITY;
+        for (const auto e : nodes[node].edges)
+        {
+            auto cost = weight(e) + g[edges[e].to];
+            if (cost < best)
+            {
+                best = cost;
+                next = e;
+            }
+        }
+        if (next == -1) break;
+
+        for (const auto& point : edges[next].polyline)
+            solution.push_back(point);
+        node = edges[next].to;
+        solution.push_back(std::tuple<int,int>(nodes[node].x, nodes[node].y));
+    }
+    return solution;
+}
+
+
+int DStarLite::getExpanded() const
+{
+    return expanded;
+}
@@ -0,0 +1,107 @@
+/*!
+ * @file dstarlite.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of incremental replanning by D* Lite
+ */
+
+#ifndef DSTARLITE_H
+#define DSTARLITE_H
+
+#include <QVector>
+#include <tuple>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+
+#include "pathfinding.h"
+
+/*!
+ * \brief Incremental shortest path search towards one goal node
+ * \details The search runs backwards from the goal over the pathfinding graph and keeps its state
+ * (distances to the goal, their one-step lookahead and the priority queue) between queries. When edges change,
+ * only their first nodes are updated and the next query repairs just the part of the search tree the change
+ * reaches. The start may move between queries (buses heading to the goal ask from wherever they are), keys
+ * stay valid lower bounds because the heuristic offset grows by the distance the start moved.
+ * Edges are weighted by their length multiplied by the traffic factor, traffic profiles are not used.
+ */
+class DStarLite
+{
+public:
+    /*!
+     * \brief constructor
+     */
+    DStarLite();
+
+    /*!
+     * \brief creates an empty search towards the goal
+     * \param graph graph with loaded points and paths, has to outlive the search
+     * \param goal node coordinates
+     */
+    DStarLite(const Pathfinding& graph, std::tuple<int,int> goal);
+
+    /*!
+     * \brief updates the search after weights or closures of edges changed in the graph
+     * \param changed indexes of changed edges
+     */
+    void updateEdges(const QVector<int>& changed);
+
+    /*!
+     * \brief finds the route from the start to the goal
+     * \param start node coordinates
+     * \return true if the goal is reachable, otherwise false
+     */
+    bool solve(std::tuple<int,int> start);
+
+    /*!
+     * \brief returns the weighted length of the route found by solve()
+     * \return INFINITY if the goal is not reachable
+     */
+    float getCost() const;
+
+    /*!
+     * \brief returns the route found by solve()
+     * \details if the goal is not reachable, only the goal node is returned (same as Pathfinding::getSolution())
+     * \return
+     */
+    QVector<std::tuple<int,int>> getSolution() const;
+
+    /*!
+     * \brief returns number of nodes expanded by the last solve()
+     * \return
+     */
+    int getExpanded() const;
+
+private:
+    typedef std::pair<float,float> Key;
+
+    /*!
+     * \brief The Entry structure
+     * \details Node waiting in the priority queue, outdated entries are skipped when they reach the top.
+     */
+    struct Entry {
+        Key key;
+        int node;
+    };
+
+    const Pathfinding* graph = nullptr;
+    int goal = -1;
+    int start = -1;
+    float km = 0.0f;                ///< Sum of distances the start moved by, added to keys
+    QVector<float> g;               ///< Distances to the goal (index is the node id)
+    QVector<float> rhs;             ///< One-step lookahead of distances
+    QVector<Key> queued;            ///< Current key of nodes in the queue
+    QVector<bool> open;             ///< True if the node is in the queue
+    QVector<Entry> heap;            ///< Binary heap of the queue
+    QVector<QVector<int>> incoming; ///< Indexes of edges entering every node
+    int expanded = 0;
+
+    float weight(int edge) const;
+    float heuristic(int node) const;
+    Key calculateKey(int node) const;
+    Key topKey();
+    void updateVertex(int node);
+    void computeShortestPath();
+};
+
+#endif // DSTARLITE_H
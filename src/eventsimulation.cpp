@@ -0,0 +1,162 @@
+/*!
+ * @file eventsimulation.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Discrete-event simulation of buses
+ */
+
+#include "eventsimulation.h"
+
+EventSimulation::EventSimulation(RouteProvider provider, int tick, bool cacheRoutes)
+    : provider(provider), tick(tick), cacheRoutes(cacheRoutes) {}
+
+
+int EventSimulation::addVehicle(int lineno, QString startStation, QString endStation, QPointF position, qint64 departure, int layover)
+{
+    Vehicle vehicle;
+    vehicle.lineno = lineno;
+    vehicle.layover = layover;
+    vehicle.startStation = startStation;
+    vehicle.lastStation = startStation;
+    vehicle.endStation = endStation;
+    vehicle.from = position;
+    vehicle.to = position;
+    vehicle.since = now;
+
+    vehicles.push_back(vehicle);
+    schedule(vehicles.size() - 1, std::max(now, departure));
+    return vehicles.size() - 1;
+}
+
+
+void EventSimulation::run(qint64 until)
+{
+    while (!queue.empty() and queue.first().at <= until)
+    {
+        std::pop_heap(queue.begin(), queue.end(), later);
+        auto event = queue.last();
+        queue.pop_back();
+
+        now = event.at;
+        ++eventCount;
+        advance(event.vehicle);
+    }
+    now = std::max(now, until);
+}
+
+
+qint64 EventSimulation::time() const
+{
+    return now;
+}
+
+
+qint64 EventSimulation::processed() const
+{
+    return eventCount;
+}
+
+
+int EventSimulation::size() const
+{
+    return vehicles.size();
+}
+
+
+const EventSimulation::Vehicle& EventSimulation::vehicle(int index) const
+{
+    return vehicles[index];
+}
+
+
+QPointF EventSimulation::position(int index) const
+{
+    const auto& vehicle = vehicles[index];
+    if (vehicle.state != Driving or vehicle.until <= vehicle.since) return vehicle.from;
+
+    auto progress = double(std::min(now, vehicle.until) - vehicle.since) / (vehicle.until - vehicle.since);
+    return vehicle.from + (vehicle.to - vehicle.from) * progress;
+}
+
+
+std::shared_ptr<const EventSimulation::Route> EventSimulation::route(const Vehicle& vehicle)
+{
+    if (!cacheRoutes)
+        return std::make_shared<const Route>(provider(vehicle.lineno, vehicle.reversed, now / 1000.0));
+
+    auto key = std::tuple<int,bool>(vehicle.lineno, vehicle.reversed);
+    auto it = routes.find(key);
+    if (it == routes.end())
+        it = routes.insert(key, std::make_shared<const Route>(provider(vehicle.lineno, vehicle.reversed, now / 1000.0)));
+    return it.value();
+}
+
+
+void EventSimulation::advance(int index)
+{
+    auto& vehicle = vehicles[index];
+
+    // departure from the start station
+    if (vehicle.state == Waiting) {
+        vehicle.route = route(vehicle);
+        if (vehicle.route->halt or vehicle.route->segments.empty()) {
+            vehicle.state = Halted;
+            return;
+        }
+
+        vehicle.segment = 0;
+        vehicle.state = Driving;
+        drive(index);
+        return;
+    }
+
+    // end of a segment
+    vehicle.from = vehicle.to;
+    const auto& station = vehicle.route->stations[vehicle.segment];
+    if (!station.isEmpty()) vehicle.lastStation = station;
+
+    if (++vehicle.segment < vehicle.route->segments.size()) {
+        drive(index);
+        return;
+    }
+
+    // bus is in the end station -> turn around and wait
+    vehicle.reversed = !vehicle.reversed;
+    std::swap(vehicle.startStation, vehicle.endStation);
+    vehicle.lastStation = vehicle.startStation;
+    vehicle.state = Waiting;
+    vehicle.since = now;
+    schedule(index, now + vehicle.layover);
+}
+
+
+void EventSimulation::drive(int index)
+{
+    auto& vehicle = vehicles[index];
+    const auto& segment = vehicle.route->segments[vehicle.segment];
+    const auto road = vehicle.route->streets[vehicle.segment];
+
+    vehicle.from = QPointF(std::get<0>(segment), std::get<1>(segment));
+    vehicle.to = QPointF(std::get<2>(segment), std::get<3>(segment));
+
+    // the traffic at the time the bus enters the segment holds until its end
+    auto slow = road ? road->traffic * road->profile.at(std::fmod(now / 1000.0, 86400.0)) : 1.0;
+    auto length = std::hypot(vehicle.to.x() - vehicle.from.x(), vehicle.to.y() - vehicle.from.y());
+
+    vehicle.since = now;
+    schedule(index, now + qint64(std::ceil(length * slow * tick)));
+}
+
+
+bool EventSimulation::later(const Event& lhs, const Event& rhs)
+{
+    return lhs.at != rhs.at ? lhs.at > rhs.at : lhs.vehicle > rhs.vehicle;
+}
+
+
+void EventSimulation::schedule(int index, qint64 at)
+{
+    vehicles[index].until = at;
+    queue.push_back(Event {at, index});
+    std::push_heap(queue.begin(), queue.end(), later);
+}
@@ -0,0 +1,185 @@
+/*!
+ * @file eventsimulation.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the discrete-event simulation of buses
+ */
+
+#ifndef EVENTSIMULATION_H
+#define EVENTSIMULATION_H
+
+#include <QMap>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <tuple>
+
+#include "datastructures.h"
+
+/*!
+ * \brief Discrete-event engine moving buses along their routes
+ * \details Instead of moving every bus in every tick, the engine keeps a priority queue of the next event of every bus
+ * (departure after a wait, end of a route segment) and jumps from one event to the next. A bus drives a segment
+ * at a constant speed given by the traffic of its street at the time it enters the segment, so its position
+ * between events is computed only when asked for by position(). Buses move as in Scene::simulate(),
+ * one pixel per tick of the given length on a street with the traffic factor 1.
+ */
+class EventSimulation
+{
+public:
+    /*!
+     * \brief The Route structure
+     * \details Route of a line in one direction, segments are the paths followed by buses.
+     */
+    struct Route {
+        QVector<std::tuple<int,int,int,int>> segments;
+        QVector<QString> stations;          ///< Station of the line at the end of every segment (empty if there is none)
+        QVector<const street*> streets;     ///< Street of every segment (nullptr if unknown)
+        bool halt = false;                  ///< True if the route does not reach all stations of the line
+    };
+
+    /*!
+     * \brief returns the route of the line for the given direction and departure time (seconds)
+     */
+    using RouteProvider = std::function<Route(int lineno, bool reversed, double departure)>;
+
+    enum State {
+        Waiting,    ///< Waiting in the start station for the departure
+        Driving,    ///< Driving the current segment of the route
+        Halted      ///< The route of the line is not valid, the bus does not move
+    };
+
+    /*!
+     * \brief The Vehicle structure
+     * \details State of one bus between its events.
+     */
+    struct Vehicle {
+        int lineno;
+        int layover;                        ///< Milliseconds waited in the end station before returning
+        State state = Waiting;
+        bool reversed = false;
+        QString startStation;
+        QString lastStation;
+        QString endStation;
+        std::shared_ptr<const Route> route; ///< Route of the current trip (nullptr before the first departure)
+        int segment = 0;                    ///< Index of the driven segment
+        QPointF from;                       ///< Position at the last event
+        QPointF to;                         ///< End of the driven segment
+        qint64 since = 0;                   ///< Time of the last event (milliseconds)
+        qint64 until = 0;                   ///< Time of the next event (milliseconds)
+    };
+
+    /*!
+     * \brief constructor
+     * \param provider computes routes of lines
+     * \param tick milliseconds of the simulated time in which a bus moves by one pixel
+     * \param cacheRoutes true if routes do not depend on the departure time and can be shared by all trips
+     */
+    EventSimulation(RouteProvider provider, int tick, bool cacheRoutes);
+
+    /*!
+     * \brief adds a bus waiting in the start station of its line
+     * \param lineno
+     * \param startStation
+     * \param endStation
+     * \param position position of the start station
+     * \param departure time of the first departure (milliseconds)
+     * \param layover milliseconds waited in the end station before returning
+     * \return index of the vehicle
+     */
+    int addVehicle(int lineno, QString startStation, QString endStation, QPointF position, qint64 departure, int layover);
+
+    /*!
+     * \brief processes all events up to the given time
+     * \param until milliseconds since the start of the simulation
+     */
+    void run(qint64 until);
+
+    /*!
+     * \brief returns the simulated time reached by run()
+     * \return milliseconds
+     */
+    qint64 time() const;
+
+    /*!
+     * \brief returns the number of processed events
+     * \return
+     */
+    qint64 processed() const;
+
+    /*!
+     * \brief returns the number of vehicles
+     * \return
+     */
+    int size() const;
+
+    /*!
+     * \brief returns a read-only reference to the vehicle
+     * \param index
+     * \return
+     */
+    const Vehicle& vehicle(int index) const;
+
+    /*!
+     * \brief computes position of the vehicle at the simulated time
+     * \param index
+     * \return
+     */
+    QPointF position(int index) const;
+
+private:
+    /*!
+     * \brief The Event structure
+     * \details Next event of a vehicle waiting in the queue.
+     */
+    struct Event {
+        qint64 at;
+        int vehicle;
+    };
+
+    RouteProvider provider;
+    int tick;
+    bool cacheRoutes;
+    QMap<std::tuple<int,bool>, std::shared_ptr<const Route>> routes;    ///< Shared routes (key is line number and direction)
+    QVector<Vehicle> vehicles;
+    QVector<Event> queue;           ///< Binary heap of the next events, the earliest first
+    qint64 now = 0;
+    qint64 eventCount = 0;
+
+    /*!
+     * \brief returns the route of the vehicle for the departure at the current time
+     * \param vehicle
+     * \return
+     */
+    std::shared_ptr<const Route> route(const Vehicle& vehicle);
+
+    /*!
+     * \brief handles the event of the vehicle and schedules its next event
+     * \param index
+     */
+    void advance(int index);
+
+    /*!
+     * \brief starts driving the current segment of the vehicle
+     * \param index
+     */
+    void drive(int index);
+
+    /*!
+     * \brief schedules the next event of the vehicle
+     * \param index
+     * \param at milliseconds since the start of the simulation
+     */
+    void schedule(int index, qint64 at);
+
+    /*!
+     * \brief orders the queue, the earliest event (on ties the vehicle with the lower index) first
+     */
+    static bool later(const Event& lhs, const Event& rhs);
+};
+
+#endif // EVENTSIMULATION_H
@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -15,17 +15,48 @@ DEFINES += QT_DEPRECATED_WARNINGS QT_NO_DEBUG_OUTPUT QT_NO_WARNING_OUTPUT QT_NO_
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# "qmake CONFIG+=profiling" compiles per-tick timers and the profiling overlay (make profiling)
+profiling: DEFINES += ICP_PROFILING
+
 SOURCES += \
+    alternativeroutes.cpp \
+    contractionhierarchy.cpp \
+    dstarlite.cpp \
+    eventsimulation.cpp \
+    itemlistmodel.cpp \
+    legcache.cpp \
     main.cpp \
     mainwindow.cpp \
+    maploader.cpp \
     pathfinding.cpp \
-    scene.cpp
+    pickindex.cpp \
+    profiler.cpp \
+    routecachefile.cpp \
+    scene.cpp \
+    simulationworker.cpp \
+    spatialgrid.cpp \
+    tracer.cpp
 
 HEADERS += \
+    alternativeroutes.h \
+    commandqueue.h \
+    contractionhierarchy.h \
     datastructures.h \
+    dstarlite.h \
+    eventsimulation.h \
+    itemlistmodel.h \
+    legcache.h \
     mainwindow.h \
+    maploader.h \
     pathfinding.h \
-    scene.h
+    pickindex.h \
+    profiler.h \
+    routecachefile.h \
+    scene.h \
+    simulationworker.h \
+    spatialgrid.h \
+    tracer.h \
+    triplebuffer.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,86 @@
+/*!
+ * @file itemlistmodel.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Filtered list of lines, buses or streets
+ */
+
+#include "itemlistmodel.h"
+
+ItemListModel::ItemListModel(QObject *parent) : QAbstractListModel(parent) {}
+
+
+void ItemListModel::setItems(const QStringList& names, const QVector<int>& keys)
+{
+    beginResetModel();
+    this->names = names;
+    this->keys = keys;
+
+    words.clear();
+    for (int item = 0; item < names.size(); ++item)
+    {
+        auto name = names[item].toLower();
+        for (int i = 0; i < name.size(); ++i)
+        {
+            if (name[i].isLetterOrNumber() and (i == 0 or !name[i - 1].isLetterOrNumber()))
+                words.push_back(std::make_pair(name.mid(i), item));
+        }
+    }
+    std::sort(words.begin(), words.end());
+
+    applyFilter();
+    endResetModel();
+}
+
+
+int ItemListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+
+QVariant ItemListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() or index.row() >= rows.size()) return QVariant();
+
+    auto item = rows[index.row()];
+    if (role == Qt::DisplayRole) return names[item];
+    if (role == Qt::UserRole) return keys[item];
+    return QVariant();
+}
+
+
+void ItemListModel::setFilter(QString text)
+{
+    text = text.trimmed().toLower();
+    if (text == filter) return;
+
+    beginResetModel();
+    filter = text;
+    applyFilter();
+    endResetModel();
+}
+
+
+void ItemListModel::applyFilter()
+{
+    rows.clear();
+    if (filter.isEmpty())
+    {
+        rows.reserve(names.size());
+        for (int item = 0; item < names.size(); ++item)
+            rows.push_back(item);
+        return;
+    }
+
+    // words starting with the filter form one range of the sorted index
+    auto word = std::lower_bound(words.begin(), words.end(), filter, [](const std::pair<QString, int>& w, const QString& prefix) {
+        return w.first < prefix;
+    });
+    for (; word != words.end() and word->first.startsWith(filter); ++word)
+        rows.push_back(word->second);
+
+    // a name matching at several words is listed once
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+}
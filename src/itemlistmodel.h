@@ -0,0 +1,77 @@
+/*!
+ * @file itemlistmodel.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the filtered list of lines, buses or streets
+ */
+
+#ifndef ITEMLISTMODEL_H
+#define ITEMLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QModelIndex>
+#include <QVariant>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include <utility>
+
+/*!
+ * \brief List of named items shown in the side panel, filtered by a prefix of any word of the name
+ * \details Only rows in the visible part of a view are rendered. Every name is indexed from the start of each
+ * of its words in a sorted array, so a filter is resolved by a binary search and costs only the number of matches.
+ */
+class ItemListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief constructor
+     * \param parent
+     */
+    explicit ItemListModel(QObject *parent = nullptr);
+
+    /*!
+     * \brief replaces all items, the current filter is kept
+     * \param names shown names
+     * \param keys keys of items returned in Qt::UserRole (same size as names)
+     */
+    void setItems(const QStringList& names, const QVector<int>& keys);
+
+    /*!
+     * \brief returns number of rows passing the filter
+     * \param parent
+     * \return
+     */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    /*!
+     * \brief returns the name (Qt::DisplayRole) or the key (Qt::UserRole) of the row
+     * \param index
+     * \param role
+     * \return
+     */
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+public slots:
+    /*!
+     * \brief shows only items with a word starting with the text (case insensitive)
+     * \param text filter, empty shows all items
+     */
+    void setFilter(QString text);
+
+private:
+    QStringList names;
+    QVector<int> keys;
+    QVector<std::pair<QString, int>> words;     ///< Lowercase names from the start of every word and indexes of their items, sorted
+    QVector<int> rows;                          ///< Indexes of items passing the filter, in the original order
+    QString filter;                             ///< Lowercase filter
+
+    /*!
+     * \brief finds rows passing the filter
+     */
+    void applyFilter();
+};
+
+#endif // ITEMLISTMODEL_H
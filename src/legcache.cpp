@@ -0,0 +1,96 @@
+/*!
+ * @file legcache.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Cache of routes between stations
+ */
+
+#include "legcache.h"
+
+LegCache::LegCache() {}
+
+
+bool LegCache::find(std::tuple<int,int> start, std::tuple<int,int> end, QVector<std::tuple<int,int>>& route)
+{
+    QMutexLocker locker(&mutex);
+    auto it = legs.find(std::tuple_cat(start, end));
+    if (it == legs.end()) return false;
+
+    route = it->route;
+    return true;
+}
+
+
+int LegCache::getEpoch()
+{
+    QMutexLocker locker(&mutex);
+    return epoch;
+}
+
+
+void LegCache::insert(std::tuple<int,int> start, std::tuple<int,int> end, const QVector<std::tuple<int,int>>& route, const QVector<int>& edges, int epoch)
+{
+    QMutexLocker locker(&mutex);
+    if (epoch != this->epoch) return;
+
+    auto key = std::tuple_cat(start, end);
+    if (legs.contains(key)) return;
+
+    legs.insert(key, Leg {route, edges});
+    for (const auto e : edges)
+        edgeLegs[e].push_back(key);
+}
+
+
+void LegCache::invalidate(const QVector<int>& edges)
+{
+    QMutexLocker locker(&mutex);
+    ++epoch;
+
+    for (const auto e : edges)
+    {
+        auto it = edgeLegs.find(e);
+        if (it == edgeLegs.end()) continue;
+
+        const auto keys = *it;
+        edgeLegs.erase(it);
+
+        // dropped legs leave the index of their other edges too
+        for (const auto& key : keys)
+        {
+            auto leg = legs.find(key);
+            if (leg == legs.end()) continue;
+
+            for (const auto other : leg->edges)
+            {
+                auto list = edgeLegs.find(other);
+                if (list != edgeLegs.end()) list->removeAll(key);
+            }
+            legs.erase(leg);
+        }
+    }
+}
+
+
+QMap<std::tuple<int,int,int,int>, LegCache::Leg> LegCache::getLegs()
+{
+    QMutexLocker locker(&mutex);
+    return legs;
+}
+
+
+void LegCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    ++epoch;
+
+    legs.clear();
+    edgeLegs.clear();
+}
+
+
+int LegCache::size()
+{
+    QMutexLocker locker(&mutex);
+    return legs.size();
+}
@@ -0,0 +1,98 @@
+/*!
+ * @file legcache.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the cache of routes between stations
+ */
+
+#ifndef LEGCACHE_H
+#define LEGCACHE_H
+
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <tuple>
+
+/*!
+ * \brief Routes of legs (routes between two stations) shared by all lines and both directions
+ * \details Every leg remembers edges of its route and every edge remembers legs going through it, so a closure
+ * or a heavier traffic drops only legs using the changed edges. Opening a street or lighter traffic may shorten
+ * any leg, so the whole cache is dropped then. Every invalidation starts a new epoch, routes searched in an older
+ * epoch are not stored. Safe to use from concurrent route queries.
+ */
+class LegCache
+{
+public:
+    /*!
+     * \brief The Leg structure
+     */
+    struct Leg {
+        QVector<std::tuple<int,int>> route;
+        QVector<int> edges;
+    };
+
+    /*!
+     * \brief constructor
+     */
+    LegCache();
+
+    /*!
+     * \brief returns the cached route of the leg
+     * \param start coordinates of the first station
+     * \param end coordinates of the second station
+     * \param route receives points of the route
+     * \return true if the leg is cached
+     */
+    bool find(std::tuple<int,int> start, std::tuple<int,int> end, QVector<std::tuple<int,int>>& route);
+
+    /*!
+     * \brief returns the current epoch
+     * \details has to be read before the search whose result is inserted
+     * \return
+     */
+    int getEpoch();
+
+    /*!
+     * \brief stores the route of the leg
+     * \param start coordinates of the first station
+     * \param end coordinates of the second station
+     * \param route points of the route
+     * \param edges indexes of edges of the route in the graph
+     * \param epoch epoch read before the route was searched, the route is dropped if the cache was invalidated since
+     */
+    void insert(std::tuple<int,int> start, std::tuple<int,int> end, const QVector<std::tuple<int,int>>& route, const QVector<int>& edges, int epoch);
+
+    /*!
+     * \brief drops legs going through any of the edges
+     * \param edges indexes of changed edges
+     */
+    void invalidate(const QVector<int>& edges);
+
+    /*!
+     * \brief returns all cached legs
+     * \return legs (key is coordinates of both stations)
+     */
+    QMap<std::tuple<int,int,int,int>, Leg> getLegs();
+
+    /*!
+     * \brief drops all legs
+     */
+    void clear();
+
+    /*!
+     * \brief returns number of cached legs
+     * \return
+     */
+    int size();
+
+private:
+    typedef std::tuple<int,int,int,int> LegKey;
+
+    QMutex mutex;
+    QMap<LegKey, Leg> legs;                 ///< Cached legs (key is coordinates of both stations)
+    QMap<int, QVector<LegKey>> edgeLegs;    ///< Legs going through every edge (key is the index of the edge)
+    int epoch = 0;
+};
+
+#endif // LEGCACHE_H
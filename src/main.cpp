@@ -8,17 +8,107 @@
 
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+/*!
+ * \brief Runs the simulation of the map without the window and prints the state of all buses.
+ * \param path path to the map
+ * \param until time of the day to simulate to ("HH:MM:SS")
+ * \return 0 on success run, others on error
+ */
+static int runHeadless(QString path, QString until)
+{
+    auto at = until.split(":");
+    auto second = at.value(0).toInt()*3600 + at.value(1).toInt()*60 + at.value(2).toInt();
+
+    Scene scene(nullptr, path);
+
+    QElapsedTimer clock;
+    clock.start();
+    auto events = scene.jumpTo(second);
+    auto elapsed = clock.elapsed();
+
+    QTextStream(stderr) << "Simulated " << until << " of " << scene.getBuses().size() << " buses: "
+                        << events << " events in " << elapsed << " ms\n";
+
+    QTextStream out(stdout);
+    out << "bus,line,x,y,street,last station,heading to,halt\n";
+    for (const auto& bus : scene.getBuses())
+    {
+        out << bus.no << "," << bus.lineno << "," << QString::number(bus.pos_x, 'f', 1) << "," << QString::number(bus.pos_y, 'f', 1)
+            << "," << bus.currStreet << "," << bus.lastStation << "," << bus.headingStation << "," << (bus.halt ? 1 : 0) << "\n";
+    }
+    return 0;
+}
+
+
+/*!
+ * \brief Writes distances between all stops of the map without the window.
+ * \param path path to the map
+ * \param out path to the written matrix (format of Scene::exportStopDistances())
+ * \return 0 on success run, others on error
+ */
+static int runStopDistances(QString path, QString out)
+{
+    Scene scene(nullptr, path);
+
+    QElapsedTimer clock;
+    clock.start();
+    if (!scene.exportStopDistances(out))
+    {
+        QTextStream(stderr) << "Cannot write stop distances to " << out << "\n";
+        return 1;
+    }
+
+    QTextStream(stderr) << "Wrote distances between stops to " << out << " in " << clock.elapsed() << " ms\n";
+    return 0;
+}
+
 
 /*!
  * \brief Main program block, generated by Qt.
+ * \details If the ICP_TRACE environment variable is set, the whole run is traced into the file it names.
+ * With "--headless <map>" the map is simulated by the discrete-event engine up to "--until" without opening the window,
+ * together with "--stop-distances <file>" the distances between all stops are written instead.
  * \param argc Argument count
  * \param argv Argument vector
  * \return 0 on success run, others on error
  */
 int main(int argc, char *argv[])
 {
+    // headless runs do not need a display
+    for (int i = 1; i < argc; ++i)
+    {
+        if (QString(argv[i]) == "--headless" and qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
-    return a.exec();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        {"headless", "Simulates the map without the window and prints the state of buses as CSV.", "map"},
+        {"until", "Time of the day the headless simulation runs to.", "HH:MM:SS", "24:00:00"},
+        {"stop-distances", "Writes distances between all stops of the headless map into the file instead of simulating.", "file"},
+    });
+    parser.process(a);
+
+    auto tracePath = qEnvironmentVariable("ICP_TRACE");
+    if (!tracePath.isEmpty()) Tracer::instance().start(tracePath);
+
+    int result;
+    if (parser.isSet("headless") and parser.isSet("stop-distances")) {
+        result = runStopDistances(parser.value("headless"), parser.value("stop-distances"));
+    } else if (parser.isSet("headless")) {
+        result = runHeadless(parser.value("headless"), parser.value("until"));
+    } else {
+        MainWindow w;
+        w.show();
+        result = a.exec();
+    }
+
+    Tracer::instance().stop();
+    return result;
 }
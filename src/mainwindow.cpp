@@ -14,11 +14,16 @@ MainWindow::MainWindow(QWidget *parent): QMainWindow(parent), ui(new Ui::MainWin
 
     this->setWindowTitle("ICP projekt 2019/2020 -- xkoprd00, xmudry01");
 
+    // the window is usable with an empty scene until the map is loaded
+    scene = new Scene(ui->graphicsView);
     initScene();
-    initScrollBoxes();
+    initLists();
+    fillLists();
+    initLoader();
+    initProfiler();
+    initTracer();
 
     connect( ui->zoomSlider,          SIGNAL(valueChanged(int)), this,  SLOT(zoom(int))                    );
-    connect( ui->speedSlider,         SIGNAL(valueChanged(int)), scene, SLOT(setSpeed(int))                );
     connect( ui->restartButton,       SIGNAL(clicked(bool)),     this,  SLOT(onClickedRestart(bool))       );
     connect( ui->playpauseButton,     SIGNAL(clicked(bool)),     this,  SLOT(onClickedPause(bool))         );
     connect( ui->clearButton,         SIGNAL(clicked(bool)),     this,  SLOT(onClickedClear(bool))         );
@@ -26,16 +31,11 @@ MainWindow::MainWindow(QWidget *parent): QMainWindow(parent), ui(new Ui::MainWin
     connect( ui->leftButton,          SIGNAL(clicked(bool)),     this,  SLOT(onClickedBackward(bool))      );
     connect( ui->blockButton,         SIGNAL(clicked(bool)),     this,  SLOT(onClickedBlock(bool))         );
     connect( ui->unblockButton,       SIGNAL(clicked(bool)),     this,  SLOT(onClickedUnblock(bool))       );
-    connect( ui->trafficSlider,       SIGNAL(valueChanged(int)), scene, SLOT(setTraffic(int))              );
     connect( ui->editOrSaveButton,    SIGNAL(clicked(bool)),     this,  SLOT(onClickedEditOrSave(bool))    );
     connect( ui->resetOrCancelButton, SIGNAL(clicked(bool)),     this,  SLOT(onClickedResetOrCancel(bool)) );
 
-    connect( scene, SIGNAL(valueChanged(int)),            this,     SLOT(changeInterval(int))      );
-    connect( scene, SIGNAL(timeValueChanged(QString)),    ui->time, SLOT(setText(QString))         );
-    connect( scene, SIGNAL(infoLabelChanged(QString)),    this,     SLOT(setInfoLabel(QString))    );
-    connect( scene, SIGNAL(trafficEnabledChanged(bool)),  this,     SLOT(setTrafficEnabled(bool))  );
-    connect( scene, SIGNAL(lineEditEnabledChanged(bool)), this,     SLOT(setLineEditEnabled(bool)) );
-    connect( scene, SIGNAL(trafficValueChanged(int)),     this,     SLOT(setTrafficSlider(int))    );
+    // the file dialog opens once the window is shown
+    QTimer::singleShot(0, this, SLOT(openMap()));
 }
 
 
@@ -47,63 +47,187 @@ MainWindow::~MainWindow()
 
 void MainWindow::initScene()
 {
-    QFileDialog dialog(this);
-    dialog.setFileMode(QFileDialog::ExistingFile);
-    auto pathToFile = dialog.getOpenFileName(this, tr("Open JSON file"), qApp->applicationDirPath(), tr("JSON File (*.json)"));
-    scene = new Scene(ui->graphicsView, pathToFile);
     ui->graphicsView->setScene(scene);
     ui->graphicsView->setRenderHint(QPainter::Antialiasing);
+
+    // only bounding rects of moved items are repainted, items restore the painter themselves
+    ui->graphicsView->setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+    ui->graphicsView->setOptimizationFlag(QGraphicsView::DontSavePainterState);
+
+    // items of buses are updated only inside the view
+    connect(ui->graphicsView->horizontalScrollBar(), SIGNAL(valueChanged(int)), scene, SLOT(renderBuses()));
+    connect(ui->graphicsView->verticalScrollBar(), SIGNAL(valueChanged(int)), scene, SLOT(renderBuses()));
+
+    connect( ui->speedSlider,       SIGNAL(valueChanged(int)), scene, SLOT(setSpeed(int))           );
+    connect( ui->trafficSlider,     SIGNAL(valueChanged(int)), scene, SLOT(setTraffic(int))         );
+    connect( ui->trafficRoutingBox, SIGNAL(toggled(bool)),     scene, SLOT(setTrafficRouting(bool)) );
+
+    connect( scene, SIGNAL(valueChanged(int)),            this,     SLOT(changeInterval(int))      );
+    connect( scene, SIGNAL(timeValueChanged(QString)),    ui->time, SLOT(setText(QString))         );
+    connect( scene, SIGNAL(infoLabelChanged(QString)),    this,     SLOT(setInfoLabel(QString))    );
+    connect( scene, SIGNAL(trafficEnabledChanged(bool)),  this,     SLOT(setTrafficEnabled(bool))  );
+    connect( scene, SIGNAL(lineEditEnabledChanged(bool)), this,     SLOT(setLineEditEnabled(bool)) );
+    connect( scene, SIGNAL(trafficValueChanged(int)),     this,     SLOT(setTrafficSlider(int))    );
+
+    scene->play();
 }
 
 
-void MainWindow::initScrollBoxes()
+void MainWindow::initLoader()
 {
-    ui->scrollAreaLines->setWidgetResizable(true);
-    auto scrollLayoutLines = new QVBoxLayout(ui->scrollAreaLines);
-    auto containerLines = new QWidget();
-    ui->scrollAreaLines->setWidget(containerLines);
-    scrollLayoutLines = new QVBoxLayout(containerLines);
+    loader = new MapLoader(this);
+
+    loadProgress = new QProgressDialog(tr("Loading the map"), tr("Cancel"), 0, Scene::LoadStageCount, this);
+    loadProgress->setWindowModality(Qt::WindowModal);
+    loadProgress->setAutoReset(false);
+    loadProgress->setAutoClose(false);
+    loadProgress->reset();
+
+    auto menu = ui->menubar->addMenu(tr("Map"));
+    auto openAction = menu->addAction(tr("Open..."));
+
+    connect( openAction,   SIGNAL(triggered(bool)),     this,   SLOT(openMap())             );
+    connect( loadProgress, SIGNAL(canceled()),          loader, SLOT(cancel())              );
+    connect( loader,       SIGNAL(progressChanged(int)), this,  SLOT(setLoadProgress(int))  );
+    connect( loader,       SIGNAL(loaded(Scene*)),      this,   SLOT(swapScene(Scene*))     );
+    connect( loader,       SIGNAL(cancelled()),         this,   SLOT(loadCancelled())       );
+}
+
 
-    ui->scrollAreaBuses->setWidgetResizable(true);
-    auto scrollLayoutBuses = new QVBoxLayout(ui->scrollAreaBuses);
-    auto containerBuses = new QWidget();
-    ui->scrollAreaBuses->setWidget(containerBuses);
-    scrollLayoutBuses = new QVBoxLayout(containerBuses);
+void MainWindow::initLists()
+{
+    linesModel = new ItemListModel(this);
+    busesModel = new ItemListModel(this);
+    streetsModel = new ItemListModel(this);
+
+    // views create widgets only for visible rows, rows of the same height are not measured one by one
+    ui->linesView->setModel(linesModel);
+    ui->busesView->setModel(busesModel);
+    ui->streetsView->setModel(streetsModel);
+
+    connect( ui->linesFilter,   SIGNAL(textChanged(QString)), linesModel,   SLOT(setFilter(QString))         );
+    connect( ui->busesFilter,   SIGNAL(textChanged(QString)), busesModel,   SLOT(setFilter(QString))         );
+    connect( ui->streetsFilter, SIGNAL(textChanged(QString)), streetsModel, SLOT(setFilter(QString))         );
+    connect( ui->linesView,     SIGNAL(clicked(QModelIndex)), this,         SLOT(onClickedLine(QModelIndex))   );
+    connect( ui->busesView,     SIGNAL(clicked(QModelIndex)), this,         SLOT(onClickedBus(QModelIndex))    );
+    connect( ui->streetsView,   SIGNAL(clicked(QModelIndex)), this,         SLOT(onClickedStreet(QModelIndex)) );
+}
 
-    ui->scrollAreaStreets->setWidgetResizable(true);
-    auto scrollLayoutStreets = new QVBoxLayout(ui->scrollAreaStreets);
-    auto containerStreets = new QWidget();
-    ui->scrollAreaStreets->setWidget(containerStreets);
-    scrollLayoutStreets = new QVBoxLayout(containerStreets);
 
+void MainWindow::fillLists()
+{
+    QStringList names;
+    QVector<int> keys;
     for (const auto& line : scene->getLines())
     {
-        auto button = new QPushButton(containerLines);
-        button->setText(QString::number(line.no));
-        connect(button, SIGNAL(clicked(bool)), this, SLOT(onClickedLine(bool)));
-        scrollLayoutLines->addWidget(button, 0);
-        button->show();
+        names.push_back(QString::number(line.no));
+        keys.push_back(line.no);
     }
+    linesModel->setItems(names, keys);
 
+    names.clear();
+    keys.clear();
     const auto& buses = scene->getBuses();
-    for (const auto& key : buses.keys())
+    for (int key = 0; key < buses.size(); ++key)
     {
-        auto button = new QPushButton(containerBuses);
-        button->setText(QString::number(buses[key].no));
-        button->setProperty("intKey", key);
-        connect(button, SIGNAL(clicked(bool)), this, SLOT(onClickedBus(bool)));
-        scrollLayoutBuses->addWidget(button, 0);
-        button->show();
+        names.push_back(QString::number(buses[key].no));
+        keys.push_back(key);
     }
+    busesModel->setItems(names, keys);
 
+    names.clear();
+    keys.clear();
     for (const auto& street : scene->getStreets())
     {
-        auto button = new QPushButton(containerStreets);
-        button->setText(street.name);
-        connect(button, SIGNAL(clicked(bool)), this, SLOT(onClickedStreet(bool)));
-        scrollLayoutStreets->addWidget(button, 0);
-        button->show();
+        names.push_back(street.name);
+        keys.push_back(keys.size());
     }
+    streetsModel->setItems(names, keys);
+}
+
+
+void MainWindow::initProfiler()
+{
+    if (!Profiler::enabled) return;
+
+    profilerOverlay = new QLabel(ui->graphicsView);
+    profilerOverlay->setStyleSheet("QLabel { background-color: rgba(255, 255, 255, 200); font-family: monospace; padding: 4px; }");
+    profilerOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    profilerOverlay->move(8, 8);
+    profilerOverlay->hide();
+
+    profilerTimer = new QTimer(this);
+    connect(profilerTimer, SIGNAL(timeout()), this, SLOT(updateProfilerOverlay()));
+
+    auto menu = ui->menubar->addMenu(tr("Profiling"));
+    auto overlayAction = menu->addAction(tr("Show overlay"));
+    overlayAction->setCheckable(true);
+    auto dumpAction = menu->addAction(tr("Dump to CSV..."));
+
+    connect( overlayAction, SIGNAL(toggled(bool)),   this, SLOT(setProfilerOverlayVisible(bool)) );
+    connect( dumpAction,    SIGNAL(triggered(bool)), this, SLOT(dumpProfile())                   );
+}
+
+
+void MainWindow::initTracer()
+{
+    auto menu = ui->menubar->addMenu(tr("Tracing"));
+    auto startAction = menu->addAction(tr("Start trace..."));
+    auto stopAction = menu->addAction(tr("Stop trace"));
+
+    connect( startAction, SIGNAL(triggered(bool)), this, SLOT(startTrace()) );
+    connect( stopAction,  SIGNAL(triggered(bool)), this, SLOT(stopTrace())  );
+}
+
+
+void MainWindow::openMap()
+{
+    QFileDialog dialog(this);
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    auto pathToFile = dialog.getOpenFileName(this, tr("Open JSON file"), qApp->applicationDirPath(), tr("JSON File (*.json)"));
+    if (pathToFile.isEmpty()) return;
+
+    loadProgress->setValue(0);
+    loadProgress->setLabelText(MapLoader::stageName(Scene::Parsing));
+    loadProgress->show();
+    loader->load(pathToFile);
+}
+
+
+void MainWindow::setLoadProgress(int stage)
+{
+    loadProgress->setLabelText(MapLoader::stageName(stage));
+    loadProgress->setValue(stage);
+}
+
+
+void MainWindow::swapScene(Scene *loaded)
+{
+    // the view switches to the new scene before the old one is deleted
+    auto old = scene;
+    old->pause();
+    scene = loaded;
+    scene->setParent(ui->graphicsView);
+    initScene();
+    fillLists();
+    old->deleteLater();
+
+    scene->setSpeed(ui->speedSlider->value());
+    scene->setTrafficRouting(ui->trafficRoutingBox->isChecked());
+
+    ui->time->setText("00:00:00");
+    setInfoLabel("Info (select item)");
+    setControlsEnabled(true);
+    setLineEditEnabled(false);
+    setTrafficEnabled(false);
+
+    loadProgress->reset();
+}
+
+
+void MainWindow::loadCancelled()
+{
+    loadProgress->reset();
 }
 
 
@@ -111,24 +235,25 @@ void MainWindow::zoom(int value)
 {
     auto tr = ui->graphicsView->transform();
     ui->graphicsView->setTransform(QTransform(value, tr.m12(), tr.m21(), value, tr.dx(), tr.dy()));
+    scene->renderBuses();
 }
 
 
 void MainWindow::changeInterval(int value)
 {
     if (value != 0) {
-        scene->timer->setInterval(scene->interval_ms/value);
+        scene->setInterval(scene->interval_ms/value);
     }
 }
 
 
-void MainWindow::onClickedLine(bool val)
+void MainWindow::onClickedLine(const QModelIndex& index)
 {
-    auto buttonSender = qobject_cast<QPushButton*>(sender());
-    auto result = scene->getLineInfo(buttonSender->text().toInt());
+    auto no = index.data(Qt::UserRole).toInt();
+    auto result = scene->getLineInfo(no);
     ui->infoLabel->setText(result);
 
-    scene->selectLine(buttonSender->text().toInt());
+    scene->selectLine(no);
     scene->deselectStreet();
 
     setLineEditEnabled(true);
@@ -136,13 +261,12 @@ void MainWindow::onClickedLine(bool val)
 }
 
 
-void MainWindow::onClickedBus(bool val)
+void MainWindow::onClickedBus(const QModelIndex& index)
 {
-    auto buttonSender = qobject_cast<QPushButton*>(sender());
-    auto result = scene->getBusInfo(buttonSender->property("intKey").toInt());
+    auto result = scene->getBusInfo(index.data(Qt::UserRole).toInt());
     ui->infoLabel->setText(result);
 
-    scene->selectLineViaBus(buttonSender->text().toInt());
+    scene->selectLineViaBus(index.data(Qt::UserRole).toInt());
     scene->deselectStreet();
 
     setLineEditEnabled(true);
@@ -150,14 +274,14 @@ void MainWindow::onClickedBus(bool val)
 }
 
 
-void MainWindow::onClickedStreet(bool val)
+void MainWindow::onClickedStreet(const QModelIndex& index)
 {
-    auto buttonSender = qobject_cast<QPushButton*>(sender());
-    auto result = scene->getStreetInfo(buttonSender->text());
+    auto name = index.data().toString();
+    auto result = scene->getStreetInfo(name);
     ui->infoLabel->setText(result);
 
     scene->deselectLine();
-    scene->selectStreet(buttonSender->text());
+    scene->selectStreet(name);
 
     setLineEditEnabled(false);
     setTrafficEnabled(true);
@@ -190,53 +314,30 @@ void MainWindow::onClickedRestart(bool val)
     scene->deselectStreet();
     ui->time->setText("00:00:00");
     scene->resetTime();
-    if (!scene->timer->isActive()) scene->simulate();
+    if (!scene->isRunning()) scene->step();
 }
 
 
 void MainWindow::onClickedPause(bool val)
 {
-    static bool isPaused = false;
-    if (!isPaused) {
-        scene->timer->stop();
-        isPaused = true;
+    if (scene->isRunning()) {
+        scene->pause();
     } else {
-        scene->timer->start();
-        isPaused = false;
+        scene->play();
     }
 }
 
 
 void MainWindow::onClickedForward(bool val)
 {
-    for (int i = 0; i < (1000/scene->interval_ms); ++i)
-    {
-        scene->updateTime();
-    }
-
-    static const auto step = 3;
-    for (int i = 0; i < (1000/scene->interval_ms/step); ++i)
-    {
-        scene->simulate(double(step));
-    }
+    scene->skip(1000);
 }
 
 
 void MainWindow::onClickedBackward(bool val)
 {
-    auto time = scene->getTime();
-    time = (time-1)*1000;
-    ui->time->setText("00:00:00");
-    scene->resetTime();
-    for (int i = 0; i < (time/scene->interval_ms); ++i)
-    {
-        scene->updateTime();
-    }
-    static const auto step = 4;
-    for (int i = 0; i < (time/scene->interval_ms/step); ++i)
-    {
-        scene->simulate(double(step));
-    }
+    // replays the simulation from the start by the discrete-event engine
+    scene->rewind(1);
 }
 
 
@@ -247,7 +348,6 @@ void MainWindow::onClickedBlock(bool val)
     bool isBlocked = scene->blockStreet(blockedStreet);
     if(isBlocked)
     {
-        scene->resetTime();
         ui->blockButton->setDisabled(true);
         ui->unblockButton->setEnabled(true);
     }
@@ -260,7 +360,6 @@ void MainWindow::onClickedUnblock(bool val)
     bool isBlocked = scene->unblockStreet(unblockedStreet);
     if(isBlocked)
     {
-        scene->resetTime();
         ui->unblockButton->setDisabled(true);
     }
 }
@@ -270,7 +369,7 @@ void MainWindow::onClickedEditOrSave(bool val)
 {
     if (scene->getEditMode() == false)
     {
-        scene->timer->stop();
+        scene->pause();
         scene->resetTime();
         scene->hideBuses(true);
 
@@ -293,7 +392,7 @@ void MainWindow::onClickedEditOrSave(bool val)
         scene->saveEdit();
 
         scene->resetTime();
-        scene->timer->start();
+        scene->play();
         scene->hideBuses(false);
 
         scene->setEditMode(false);
@@ -314,7 +413,7 @@ void MainWindow::onClickedResetOrCancel(bool val)
     }
     else if (scene->getEditMode() == true)
     {
-        scene->timer->start();
+        scene->play();
         scene->hideBuses(false);
 
         setControlsEnabled(true);
@@ -348,9 +447,12 @@ void MainWindow::setControlsEnabled(bool val)
     ui->playpauseButton->setEnabled(val);
     ui->rightButton->setEnabled(val);
     ui->clearButton->setEnabled(val);
-    ui->scrollAreaLines->setEnabled(val);
-    ui->scrollAreaBuses->setEnabled(val);
-    ui->scrollAreaStreets->setEnabled(val);
+    ui->linesView->setEnabled(val);
+    ui->busesView->setEnabled(val);
+    ui->streetsView->setEnabled(val);
+    ui->linesFilter->setEnabled(val);
+    ui->busesFilter->setEnabled(val);
+    ui->streetsFilter->setEnabled(val);
 }
 
 void MainWindow::setTrafficSlider(int val)
@@ -370,3 +472,55 @@ void MainWindow::setLineEditEnabled(bool val)
         ui->resetOrCancelButton->setText("Reset All");
     }
 }
+
+
+void MainWindow::setProfilerOverlayVisible(bool val)
+{
+    if (!profilerOverlay) return;
+
+    profilerOverlay->setVisible(val);
+    if (val) {
+        updateProfilerOverlay();
+        profilerTimer->start(500);
+    } else {
+        profilerTimer->stop();
+    }
+}
+
+
+void MainWindow::updateProfilerOverlay()
+{
+    profilerOverlay->setText(Profiler::instance().summary());
+    profilerOverlay->adjustSize();
+}
+
+
+void MainWindow::dumpProfile()
+{
+    auto path = QFileDialog::getSaveFileName(this, tr("Save profile"), QString(), tr("CSV File (*.csv)"));
+    if (path.isEmpty()) return;
+
+    if (!Profiler::instance().dumpCsv(path))
+        setInfoLabel("Cannot write the profile into " + path);
+}
+
+
+void MainWindow::startTrace()
+{
+    auto path = QFileDialog::getSaveFileName(this, tr("Save trace"), QString(), tr("Trace File (*.json)"));
+    if (path.isEmpty()) return;
+
+    Tracer::instance().start(path);
+    setInfoLabel("Recording trace into " + path);
+}
+
+
+void MainWindow::stopTrace()
+{
+    if (!Tracer::instance().isActive()) return;
+
+    if (Tracer::instance().stop())
+        setInfoLabel("Trace saved, open it in Perfetto (ui.perfetto.dev) or chrome://tracing");
+    else
+        setInfoLabel("Cannot write the trace");
+}
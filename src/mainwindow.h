@@ -11,7 +11,14 @@
 #include <QMainWindow>
 #include <QMouseEvent>
 #include <QFileDialog>
+#include <QLabel>
+#include <QMenuBar>
+#include <QAction>
+#include <QTimer>
+#include <QProgressDialog>
 #include "scene.h"
+#include "maploader.h"
+#include "itemlistmodel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -54,21 +61,21 @@ private slots:
 
     /*!
      * \brief gets info about selected line
-     * \param val
+     * \param index row of the list of lines
      */
-    void onClickedLine(bool val);
+    void onClickedLine(const QModelIndex& index);
 
     /*!
      * \brief gets info about selected bus
-     * \param val
+     * \param index row of the list of buses
      */
-    void onClickedBus(bool val);
+    void onClickedBus(const QModelIndex& index);
 
     /*!
      * \brief gets info about selected street
-     * \param val
+     * \param index row of the list of streets
      */
-    void onClickedStreet(bool val);
+    void onClickedStreet(const QModelIndex& index);
 
     /*!
      * \brief makes default map without any selection
@@ -154,20 +161,97 @@ private slots:
      */
     void setLineEditEnabled(bool val);
 
+    /*!
+     * \brief shows or hides the profiling overlay
+     * \param val
+     */
+    void setProfilerOverlayVisible(bool val);
+
+    /*!
+     * \brief overwrites the profiling overlay with the current statistics
+     */
+    void updateProfilerOverlay();
+
+    /*!
+     * \brief writes recorded ticks of the profiler into a CSV file selected by the user
+     */
+    void dumpProfile();
+
+    /*!
+     * \brief starts recording a trace into a file selected by the user
+     */
+    void startTrace();
+
+    /*!
+     * \brief stops recording and writes the trace
+     */
+    void stopTrace();
+
+    /*!
+     * \brief asks for a map and starts loading it in the background
+     */
+    void openMap();
+
+    /*!
+     * \brief shows the stage of loading the map
+     * \param stage Scene::LoadStage
+     */
+    void setLoadProgress(int stage);
+
+    /*!
+     * \brief replaces the shown scene by the loaded one
+     * \param loaded
+     */
+    void swapScene(Scene *loaded);
+
+    /*!
+     * \brief hides the progress of a cancelled load
+     */
+    void loadCancelled();
+
 private:
     Ui::MainWindow *ui;
     QPointF pos;
     Scene * scene;
+    QLabel * profilerOverlay = nullptr;     ///< Statistics of the profiler drawn over the scene
+    QTimer * profilerTimer = nullptr;       ///< Refreshes the profiling overlay
+    MapLoader * loader = nullptr;           ///< Loads maps in the background
+    QProgressDialog * loadProgress = nullptr;
+    ItemListModel * linesModel = nullptr;   ///< Lines in the side panel (key is the number of the line)
+    ItemListModel * busesModel = nullptr;   ///< Buses in the side panel (key is the index of the bus)
+    ItemListModel * streetsModel = nullptr; ///< Streets in the side panel
 
     /*!
-     * \brief initializes scene
+     * \brief shows the scene in the view and connects it to controls
+     * \details called for the empty scene created with the window and for every loaded map
      */
     void initScene();
 
     /*!
-     * \brief initializes scroll boxes
+     * \brief creates the map loader, its progress dialog and the map menu
+     */
+    void initLoader();
+
+    /*!
+     * \brief attaches models and search fields to lists of lines, buses and streets
+     */
+    void initLists();
+
+    /*!
+     * \brief fills lists of lines, buses and streets from the scene
+     */
+    void fillLists();
+
+    /*!
+     * \brief creates the profiling menu and overlay
+     * \details does nothing unless the program is built with profiling enabled
+     */
+    void initProfiler();
+
+    /*!
+     * \brief creates the tracing menu
      */
-    void initScrollBoxes();
+    void initTracer();
 
     friend class Scene;
 
@@ -0,0 +1,114 @@
+/*!
+ * @file maploader.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Loading maps in the background
+ */
+
+#include "maploader.h"
+
+MapLoader::MapLoader(QObject *parent) : QObject(parent)
+{
+    pool.setMaxThreadCount(1);
+}
+
+
+MapLoader::~MapLoader()
+{
+    for (auto loading : loads)
+        loading->cancelled = true;
+    pool.waitForDone();
+
+    for (auto loading : loads)
+    {
+        delete loading->scene;
+        delete loading;
+    }
+}
+
+
+void MapLoader::load(QString path)
+{
+    discard();
+
+    // the scene is created on the GUI thread, so its timers and items belong to it
+    auto loading = new Load;
+    loading->scene = new Scene();
+    loading->watcher = new QFutureWatcher<bool>(this);
+    connect(loading->watcher, SIGNAL(finished()), this, SLOT(finish()));
+    loads.push_back(loading);
+    current = loading;
+
+    auto scene = loading->scene;
+    auto cancelled = &loading->cancelled;
+    loading->watcher->setFuture(QtConcurrent::run(&pool, [this, scene, path, cancelled]() {
+        return scene->loadModel(path, [this, cancelled](int stage) {if (!*cancelled) emit progressChanged(stage);}, cancelled);
+    }));
+}
+
+
+bool MapLoader::isLoading() const
+{
+    return current != nullptr;
+}
+
+
+QString MapLoader::stageName(int stage)
+{
+    switch (stage) {
+        case Scene::Parsing:       return tr("Parsing the map");
+        case Scene::BuildingGraph: return tr("Building the graph");
+        case Scene::Routing:       return tr("Routing lines");
+        case Scene::CreatingItems: return tr("Creating items");
+        default:                   return "";
+    }
+}
+
+
+void MapLoader::cancel()
+{
+    if (current) current->cancelled = true;
+}
+
+
+void MapLoader::finish()
+{
+    auto it = std::find_if(loads.begin(), loads.end(), [this](const Load *l) {return l->watcher == sender();});
+    if (it == loads.end()) return;
+
+    auto done = *it;
+    loads.erase(it);
+    auto ready = done->scene;
+    auto replaced = done != current;
+    auto ok = !done->cancelled and done->watcher->result();
+    done->watcher->deleteLater();
+    delete done;
+
+    // a replaced load was cancelled by discard(), the window waits for the newer one
+    if (replaced)
+    {
+        delete ready;
+        return;
+    }
+
+    current = nullptr;
+    if (!ok)
+    {
+        delete ready;
+        emit cancelled();
+        return;
+    }
+
+    emit progressChanged(Scene::CreatingItems);
+    ready->createItems();
+    emit loaded(ready);
+}
+
+
+void MapLoader::discard()
+{
+    if (!current) return;
+
+    current->cancelled = true;
+    current = nullptr;
+}
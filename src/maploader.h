@@ -0,0 +1,118 @@
+/*!
+ * @file maploader.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of loading maps in the background
+ */
+
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QVector>
+#include <atomic>
+#include <algorithm>
+
+#include "scene.h"
+
+/*!
+ * \brief Loads a map into a new scene on a background thread
+ * \details Parsing, building the graph and routing run on a thread of the loader, graphics items are created
+ * on the GUI thread once the model is ready. Progress is reported when a stage starts. A cancelled or replaced
+ * load stops at its next stage or routing job, the GUI thread never waits for it, its scene is deleted once
+ * its future finishes. The scene shown in the window is never touched.
+ */
+class MapLoader : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief constructor
+     * \param parent
+     */
+    explicit MapLoader(QObject *parent = nullptr);
+
+    /*!
+     * \brief destructor
+     * \details cancels running loads and waits for them
+     */
+    ~MapLoader();
+
+    /*!
+     * \brief starts loading the map, a running load is cancelled first
+     * \param path path to the map
+     */
+    void load(QString path);
+
+    /*!
+     * \brief returns true if a map is being loaded
+     * \return
+     */
+    bool isLoading() const;
+
+    /*!
+     * \brief returns a name of the stage shown to the user
+     * \param stage Scene::LoadStage
+     * \return
+     */
+    static QString stageName(int stage);
+
+public slots:
+    /*!
+     * \brief cancels the running load
+     */
+    void cancel();
+
+signals:
+    /*!
+     * \brief a stage of loading started
+     * \param stage Scene::LoadStage
+     */
+    void progressChanged(int stage);
+
+    /*!
+     * \brief the map is loaded
+     * \param scene loaded scene, the receiver takes the ownership
+     */
+    void loaded(Scene *scene);
+
+    /*!
+     * \brief the load was cancelled
+     */
+    void cancelled();
+
+private slots:
+    /*!
+     * \brief creates items of the loaded scene or deletes the scene of a cancelled or replaced load
+     * \details called by the watcher of the finished load
+     */
+    void finish();
+
+private:
+    /*!
+     * \brief The Load structure
+     * \details One load running on the thread of the loader.
+     */
+    struct Load {
+        Scene *scene = nullptr;
+        QFutureWatcher<bool> *watcher = nullptr;
+        std::atomic<bool> cancelled {false};
+    };
+
+    QThreadPool pool;                   ///< Own thread, threads of the global pool route lines in parallel during loading
+    QVector<Load*> loads;               ///< Loads whose future did not finish yet
+    Load *current = nullptr;            ///< Load shown by the progress, nullptr if it was replaced, cancelled or finished
+
+    /*!
+     * \brief cancels the current load without waiting for it
+     * \details its scene is deleted by finish()
+     */
+    void discard();
+};
+
+#endif // MAPLOADER_H
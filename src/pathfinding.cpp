@@ -12,240 +12,430 @@ Pathfinding::Pathfinding(QObject *parent) : QObject(parent) {}
 
 void Pathfinding::loadPoints(const QVector<std::tuple<int,int>>& points)
 {
-    int i = 0;
     for (const auto& point : points)
     {
-        if (nodesMap.contains(point)) continue;
-
-        Node node;
-        node.x = std::get<0>(point);
-        node.y = std::get<1>(point);
-        node.obstacle = false;
-        node.visited = false;
-        node.parent = nullptr;
-
-        nodesMap.insert(point, node);
-        ++nodeNum;
-        ++i;
+        addNode(point);
     }
 }
 
 
-void Pathfinding::resetPoints()
+int Pathfinding::addNode(std::tuple<int,int> point)
 {
-    for (auto& node : nodesMap)
+    auto it = nodeIndex.find(point);
+    if (it != nodeIndex.end()) return *it;
+
+    Node node;
+    node.id = nodeNum;
+    node.x = std::get<0>(point);
+    node.y = std::get<1>(point);
+
+    nodes.push_back(node);
+    nodeIndex.insert(point, nodeNum);
+    return nodeNum++;
+}
+
+
+void Pathfinding::resetClosures()
+{
+    for (auto& edge : edges)
     {
-        node.visited = false;
-        node.obstacle = false;
-        node.parent = nullptr;
+        edge.closed = false;
     }
 }
 
 
-void Pathfinding::loadPaths(QMap<QString, street>& streets, QVector<std::tuple<int,int>>& points)
+void Pathfinding::loadPaths(const QMap<QString, street>& streets)
 {
-    for (auto& street : streets)
+    struct Segment {
+        std::tuple<int,int> a;
+        std::tuple<int,int> b;
+        QString street;
+    };
+    QVector<Segment> segments;
+    QMap<std::tuple<int,int>, QVector<int>> incident;  ///< Segments touching every point
+
+    for (const auto& street : streets)
     {
         for (const auto& path : street.pathLines)
         {
-            auto x1 = std::get<0>(path);
-            auto y1 = std::get<1>(path);
-            auto x2 = std::get<2>(path);
-            auto y2 = std::get<3>(path);
+            auto a = std::tuple<int,int>(std::get<0>(path), std::get<1>(path));
+            auto b = std::tuple<int,int>(std::get<2>(path), std::get<3>(path));
+            if (a == b) continue;
 
-            // adds extra node inbetween nodes which are going to be connected to allow block/unblock street functionality
-            for (auto& node : nodesMap)
-            {
-                if (node.x == x1 and node.y == y1) {
-                    auto start_node_coord = std::tuple<int,int>(node.x, node.y);
-                    auto end_node_coord = std::tuple<int,int>(x2, y2);
+            incident[a].push_back(segments.size());
+            incident[b].push_back(segments.size());
+            segments.push_back(Segment {a, b, street.name});
+        }
+    }
+
+    // a point stays a node unless exactly two segments of the same street meet in it
+    auto isNode = [this, &segments, &incident](std::tuple<int,int> point) {
+        if (nodeIndex.contains(point)) return true;
+        const auto& touching = incident[point];
+        return touching.size() != 2 or segments[touching[0]].street != segments[touching[1]].street;
+    };
 
-                    int new_x;
-                    int new_y;
+    for (auto it = incident.begin(); it != incident.end(); ++it)
+    {
+        if (isNode(it.key())) addNode(it.key());
+    }
+
+    QVector<bool> used(segments.size(), false);
+    auto walk = [&](std::tuple<int,int> start, int first) {
+        Edge edge;
+        edge.from = nodeIndex[start];
+        edge.length = 0.0f;
+        auto point = start;
+        auto segment = first;
+
+        // follows the chain until it reaches the next node
+        while (true)
+        {
+            used[segment] = true;
+            const auto& s = segments[segment];
+            auto next = s.a == point ? s.b : s.a;
+            edge.length += sqrtf(powf(std::get<0>(next) - std::get<0>(point), 2) + powf(std::get<1>(next) - std::get<1>(point), 2));
+            point = next;
 
-                    if (node.x >= x2)
-                        new_x = (node.x - x2)/2 + x2;
-                    else
-                        new_x = (x2 - node.x)/2 + node.x;
+            if (nodeIndex.contains(point)) break;
 
-                    if (node.y >= y2)
-                        new_y = (node.y - y2)/2 + y2;
-                    else
-                        new_y = (y2 - node.y)/2 + node.y;
+            edge.polyline.push_back(point);
+            const auto& touching = incident[point];
+            segment = touching[0] == segment ? touching[1] : touching[0];
+        }
+        edge.to = nodeIndex[point];
 
-                    auto new_coord = std::tuple<int,int>(new_x, new_y);
+        auto reverse = edge;
+        std::swap(reverse.from, reverse.to);
+        std::reverse(reverse.polyline.begin(), reverse.polyline.end());
 
-                    if (!nodesMap.contains(new_coord)) {
-                        Node new_node;
-                        new_node.x = new_x;
-                        new_node.y = new_y;
-                        node.obstacle = false;
-                        node.visited = false;
-                        node.parent = nullptr;
+        for (int i = 0; i < edge.polyline.size(); ++i)
+            edgePoints.insert(edge.polyline[i], std::pair<int,int>(edges.size(), i));
 
-                        if (!points.contains(new_coord))
-                            points.push_back(new_coord);
+        const auto& name = segments[first].street;
+        for (const auto& e : {edge, reverse})
+        {
+            nodes[e.from].edges.push_back(edges.size());
+            streetEdges[name].push_back(edges.size());
+            edges.push_back(e);
+        }
+    };
 
-                        if (!street.mid.contains(new_coord))
-                            street.mid.push_back(new_coord);
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        auto point = std::tuple<int,int>(nodes[i].x, nodes[i].y);
+        for (const auto segment : incident.value(point))
+        {
+            if (!used[segment]) walk(point, segment);
+        }
+    }
 
-                        new_node.neighbours.push_back(&nodesMap[start_node_coord]);
-                        new_node.neighbours.push_back(&nodesMap[end_node_coord]);
+    // closed loops without any node get a node in their first point
+    for (int i = 0; i < segments.size(); ++i)
+    {
+        if (used[i]) continue;
+        addNode(segments[i].a);
+        walk(segments[i].a, i);
+    }
+}
 
-                        nodesMap.insert(new_coord, new_node);
-                        ++nodeNum;
-                    }
 
-                    node.neighbours.push_back(&nodesMap[new_coord]);
+const QVector<Pathfinding::Edge>& Pathfinding::getEdges() const
+{
+    return edges;
+}
 
 
-                }
-                else if (node.x == x2 and node.y == y2) {
-                    auto start_node_coord = std::tuple<int,int>(node.x, node.y);
-                    auto end_node_coord = std::tuple<int,int>(x1, y1);
+const QMap<QString, QVector<int>>& Pathfinding::getStreetEdges() const
+{
+    return streetEdges;
+}
 
-                    int new_x;
-                    int new_y;
 
-                    if (node.x >= x1)
-                        new_x = (node.x - x1)/2 + x1;
-                    else
-                        new_x = (x1 - node.x)/2 + node.x;
+int Pathfinding::findNode(std::tuple<int,int> point) const
+{
+    return nodeIndex.value(point, -1);
+}
 
-                    if (node.y >= y1)
-                        new_y = (node.y - y1)/2 + y1;
-                    else
-                        new_y = (y1 - node.y)/2 + node.y;
 
-                    auto new_coord = std::tuple<int,int>(new_x, new_y);
+int Pathfinding::findEdge(std::tuple<int,int> point, int& position) const
+{
+    auto it = edgePoints.find(point);
+    if (it == edgePoints.end()) return -1;
 
-                    if (!nodesMap.contains(new_coord)) {
-                        Node new_node;
-                        new_node.x = new_x;
-                        new_node.y = new_y;
-                        node.obstacle = false;
-                        node.visited = false;
-                        node.parent = nullptr;
+    position = it->second;
+    return it->first;
+}
 
-                        if (!points.contains(new_coord))
-                            points.push_back(new_coord);
 
-                        if (!street.mid.contains(new_coord))
-                            street.mid.push_back(new_coord);
+bool Pathfinding::setStreetClosed(const QString& name, bool closed)
+{
+    auto it = streetEdges.find(name);
+    if (it == streetEdges.end()) return false;
 
-                        new_node.neighbours.push_back(&nodesMap[start_node_coord]);
-                        new_node.neighbours.push_back(&nodesMap[end_node_coord]);
+    for (const auto e : *it)
+        edges[e].closed = closed;
+    return true;
+}
 
-                        nodesMap.insert(new_coord, new_node);
-                        ++nodeNum;
-                    }
 
-                    node.neighbours.push_back(&nodesMap[new_coord]);
-                }
-            }
-        }
+bool Pathfinding::setStreetCost(const QString& name, float cost)
+{
+    auto it = streetEdges.find(name);
+    if (it == streetEdges.end()) return false;
+
+    for (const auto e : *it)
+        edges[e].cost = cost;
+    return true;
+}
+
+
+QVector<std::tuple<int,int>> Pathfinding::getSolution()
+{
+    return getSolution(workspace);
+}
+
+
+QVector<std::tuple<int,int>> Pathfinding::getSolution(const Workspace& workspace) const
+{
+    return workspace.solution;
+}
+
+
+void Pathfinding::buildSolution(Workspace& workspace) const
+{
+    auto& solution = workspace.solution;
+    solution.clear();
+    if (workspace.nodeEnd == nullptr) return;
+
+    // route is collected from the end and reversed afterwards, polylines of edges are expanded on the way
+    auto p = workspace.nodeEnd;
+    while (workspace.parent.size() > p->id and workspace.parent[p->id] != -1)
+    {
+        const auto& edge = edges[workspace.parent[p->id]];
+        solution.push_back(std::tuple<int,int>(p->x,p->y));
+        for (int i = edge.polyline.size() - 1; i >= 0; --i)
+            solution.push_back(edge.polyline[i]);
+        p = &nodes[edge.from];
     }
+    solution.push_back(std::tuple<int,int>(p->x,p->y));
+    std::reverse(solution.begin(), solution.end());
 }
 
 
-bool Pathfinding::setNodeObstacle(std::tuple<int,int> point, bool obstacle)
+QVector<int> Pathfinding::getSolutionEdges(const Workspace& workspace) const
 {
-    auto x = std::get<0>(point);
-    auto y = std::get<1>(point);
+    QVector<int> route;
+    if (workspace.nodeEnd == nullptr) return route;
 
-    for (auto& node : nodesMap)
+    auto id = workspace.nodeEnd->id;
+    while (workspace.parent.size() > id and workspace.parent[id] != -1)
     {
-        if (node.x == x and node.y == y)
-        {
-            if (obstacle)
-                node.obstacle = true;
-            else
-                node.obstacle = false;
-            return true;
-        }
+        route.push_back(workspace.parent[id]);
+        id = edges[workspace.parent[id]].from;
     }
-    return false;
+    if (workspace.nodeStart == nullptr or id != workspace.nodeStart->id) return QVector<int>();
+
+    std::reverse(route.begin(), route.end());
+    return route;
 }
 
 
-QVector<std::tuple<int,int>> Pathfinding::getSolution()
+QVector<Pathfinding::NodeSnapshot> Pathfinding::returnGraph() const
 {
-    QVector<std::tuple<int,int>> solution;
-    if (nodeEnd != nullptr)
+    QVector<NodeSnapshot> snapshot(nodeNum);
+    for (const auto& node : nodes)
     {
-        Node *p = nodeEnd;
-        while (p->parent != nullptr)
-        {
-            solution.push_front(std::tuple<int,int>(p->x,p->y));
-            p = p->parent;
-        }
-        solution.push_front(std::tuple<int,int>(p->x,p->y));
+        auto& copy = snapshot[node.id];
+        copy = NodeSnapshot {node.id, node.x, node.y, QVector<int>()};
+        copy.neighbours.reserve(node.edges.size());
+        for (const auto e : node.edges)
+            copy.neighbours.push_back(edges[e].to);
     }
-    return solution;
+    return snapshot;
 }
 
 
-QMap<std::tuple<int, int>, Pathfinding::Node> Pathfinding::returnGraph()
+const QVector<Pathfinding::Node>& Pathfinding::getGraph() const
 {
-    return nodesMap;
+    return nodes;
 }
 
 
 void Pathfinding::loadGoal(std::tuple<int, int> start, std::tuple<int, int> end)
 {
-    nodeStart = &nodesMap[start];
-    nodeEnd = &nodesMap[end];
+    loadGoal(start, end, workspace);
+}
+
+
+void Pathfinding::loadGoal(std::tuple<int, int> start, std::tuple<int, int> end, Workspace& workspace) const
+{
+    auto itStart = nodeIndex.find(start);
+    auto itEnd = nodeIndex.find(end);
+    workspace.nodeStart = itStart != nodeIndex.end() ? &nodes[*itStart] : nullptr;
+    workspace.nodeEnd = itEnd != nodeIndex.end() ? &nodes[*itEnd] : nullptr;
 }
 
 
 bool Pathfinding::solveAStar()
 {
-    for (auto& node : nodesMap)
-    {
-        node.visited = false;
-        node.parent = nullptr;
-        node.globalGoal = INFINITY;
-        node.localGoal = INFINITY;
-    }
+    return solveAStar(workspace);
+}
+
+
+bool Pathfinding::solveAStar(double departure, double speed)
+{
+    return solveAStar(departure, speed, workspace);
+}
 
-    auto distance = [](Node *a, Node *b) {return sqrtf(powf(a->x - b->x, 2) + powf(a->y - b->y, 2));};
-    auto heuristic = [distance](Node *a, Node *b) {return distance(a, b);};
 
-    Node *nodeCurrent = nodeStart;
-    nodeStart->localGoal = 0.0f;
-    nodeStart->globalGoal = heuristic(nodeStart, nodeEnd);
+bool Pathfinding::solveAStar(Workspace& workspace) const
+{
+    return search([](const Edge& edge, float) {return edge.length * edge.cost;}, workspace);
+}
+
+
+bool Pathfinding::solveAStar(double departure, double speed, Workspace& workspace) const
+{
+    return search([this, departure, speed](const Edge& edge, float localGoal) {
+        auto factor = edge.cost;
+        if (edge.profile >= 0)
+            factor *= std::max(1.0f, profiles[edge.profile].at(departure + localGoal / speed));
+        return edge.length * factor;
+    }, workspace);
+}
 
-    std::list<Node*> notTestedNodes;
-    notTestedNodes.push_back(nodeStart);
 
-    while (!notTestedNodes.empty()) {
-        notTestedNodes.sort([](const Node* lhs, const Node* rhs) {return lhs->globalGoal < rhs->globalGoal;});
+bool Pathfinding::solveAStar(const QVector<float>& factors, Workspace& workspace) const
+{
+    return search([this, &factors](const Edge& edge, float) {return edge.length * factors[&edge - edges.constData()];}, workspace);
+}
 
-        while (!notTestedNodes.empty() and notTestedNodes.front()->visited)
+
+float Pathfinding::getSolutionCost()
+{
+    return getSolutionCost(workspace);
+}
+
+
+float Pathfinding::getSolutionCost(const Workspace& workspace) const
+{
+    if (workspace.nodeEnd == nullptr or workspace.localGoal.size() <= workspace.nodeEnd->id) return INFINITY;
+    return workspace.localGoal[workspace.nodeEnd->id];
+}
+
+
+int Pathfinding::addProfile(const TrafficProfile& profile)
+{
+    profiles.push_back(profile);
+    return profiles.size() - 1;
+}
+
+
+bool Pathfinding::setStreetProfile(const QString& name, int profile)
+{
+    auto it = streetEdges.find(name);
+    if (it == streetEdges.end()) return false;
+
+    for (const auto e : *it)
+        edges[e].profile = profile;
+    return true;
+}
+
+
+bool Pathfinding::hasProfiles() const
+{
+    return !profiles.isEmpty();
+}
+
+
+template<typename Weight>
+bool Pathfinding::search(Weight weight, Workspace& workspace) const
+{
+    auto& visited = workspace.visited;
+    auto& globalGoal = workspace.globalGoal;
+    auto& localGoal = workspace.localGoal;
+    auto& parent = workspace.parent;
+    auto& touched = workspace.touched;
+    auto& open = workspace.open;
+
+    if (visited.size() != nodeNum)
+    {
+        visited.fill(false, nodeNum);
+        globalGoal.fill(INFINITY, nodeNum);
+        localGoal.fill(INFINITY, nodeNum);
+        parent.fill(-1, nodeNum);
+    }
+    else
+    {
+        for (const auto id : touched)
         {
-            notTestedNodes.pop_front();
+            visited[id] = false;
+            globalGoal[id] = INFINITY;
+            localGoal[id] = INFINITY;
+            parent[id] = -1;
         }
+    }
+    touched.clear();
+    open.clear();
+    workspace.expanded = 0;
+    workspace.maxOpen = 0;
+
+    auto nodeStart = workspace.nodeStart;
+    auto nodeEnd = workspace.nodeEnd;
+    if (nodeStart == nullptr or nodeEnd == nullptr) {
+        buildSolution(workspace);
+        return false;
+    }
 
-        if (notTestedNodes.empty()) break;
+    auto distance = [](const Node *a, const Node *b) {return sqrtf(powf(a->x - b->x, 2) + powf(a->y - b->y, 2));};
+    auto heuristic = [distance](const Node *a, const Node *b) {return distance(a, b);};
+    auto lowerGoalFirst = [](const OpenEntry& lhs, const OpenEntry& rhs) {return lhs.globalGoal > rhs.globalGoal;};
 
-        nodeCurrent = notTestedNodes.front();
-        nodeCurrent->visited = true;
+    localGoal[nodeStart->id] = 0.0f;
+    globalGoal[nodeStart->id] = heuristic(nodeStart, nodeEnd);
+    touched.push_back(nodeStart->id);
+    open.push_back(OpenEntry {globalGoal[nodeStart->id], nodeStart});
 
-        for (auto nodeNeighbour : nodeCurrent->neighbours)
+    // entries are not removed when a node gets a lower goal, outdated entries are skipped as visited
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), lowerGoalFirst);
+        const Node *nodeCurrent = open.last().node;
+        open.pop_back();
+
+        if (visited[nodeCurrent->id]) continue;
+
+        visited[nodeCurrent->id] = true;
+        ++workspace.expanded;
+
+        // the heuristic never overestimates, so the goal of the end node is final
+        if (nodeCurrent == nodeEnd) break;
+
+        for (const auto e : nodeCurrent->edges)
         {
-            if (!nodeNeighbour->visited and nodeNeighbour->obstacle == false)
-                notTestedNodes.push_back(nodeNeighbour);
+            const auto& edge = edges[e];
+            if (edge.closed) continue;
 
-            float possiblyLowerGoal = nodeCurrent->localGoal + distance(nodeCurrent, nodeNeighbour);
+            const Node* nodeNeighbour = &nodes[edge.to];
+            float possiblyLowerGoal = localGoal[nodeCurrent->id] + weight(edge, localGoal[nodeCurrent->id]);
 
-            if (possiblyLowerGoal < nodeNeighbour->localGoal)
+            if (possiblyLowerGoal < localGoal[nodeNeighbour->id])
             {
-                nodeNeighbour->parent = nodeCurrent;
-                nodeNeighbour->localGoal = possiblyLowerGoal;
-                nodeNeighbour->globalGoal = nodeNeighbour->localGoal + heuristic(nodeNeighbour, nodeEnd);
+                if (localGoal[nodeNeighbour->id] == INFINITY) touched.push_back(nodeNeighbour->id);
+
+                parent[nodeNeighbour->id] = e;
+                localGoal[nodeNeighbour->id] = possiblyLowerGoal;
+                globalGoal[nodeNeighbour->id] = localGoal[nodeNeighbour->id] + heuristic(nodeNeighbour, nodeEnd);
+
+                if (!visited[nodeNeighbour->id]) {
+                    open.push_back(OpenEntry {globalGoal[nodeNeighbour->id], nodeNeighbour});
+                    std::push_heap(open.begin(), open.end(), lowerGoalFirst);
+                }
             }
         }
+        workspace.maxOpen = std::max(workspace.maxOpen, int(open.size()));
     }
 
+    buildSolution(workspace);
     return true;
 }
@@ -13,8 +13,8 @@
 #include <QMap>
 #include <tuple>
 #include <cmath>
-#include <list>
 #include <vector>
+#include <algorithm>
 
 #include "datastructures.h"
 
@@ -23,6 +23,9 @@
  * \details Creates a graph from nodes from given input of points and paths between them and
  * performs the A* algorithm to find the shortest route for given start and end nodes.
  * The resulting path is used by a line and buses following the line.
+ * Nodes are only stations, crossings and ends of streets, chains of segments of one street between them
+ * are contracted into single edges carrying the polyline of the chain. Closures, traffic factors and traffic
+ * profiles are stored in edges, the geometry is expanded only when the solution is built.
  */
 class Pathfinding : public QObject
 {
@@ -30,16 +33,66 @@ class Pathfinding : public QObject
 public:
     /*!
      * \brief The Node structure
+     * \details Immutable during queries, search state is kept in a Workspace.
      */
     struct Node {
-        bool obstacle = false;
-        bool visited = false;
-        float globalGoal;
-        float localGoal;
+        int id = -1;            ///< Index of the node in the graph and in search workspaces
+        int x;
+        int y;
+        QVector<int> edges;     ///< Indexes of edges leaving the node
+    };
+
+    /*!
+     * \brief The Edge structure
+     * \details Directed chain of segments of one street between two nodes, every chain is stored in both directions.
+     */
+    struct Edge {
+        int from;
+        int to;
+        float length;           ///< Length of the whole polyline
+        bool closed = false;    ///< True if the street is blocked
+        float cost = 1.0f;      ///< Traffic factor of the street, multiplies the length
+        int profile = -1;       ///< Index of the traffic profile of the street (-1 if the traffic does not change during the day)
+        QVector<std::tuple<int,int>> polyline;  ///< Points between the nodes in the direction of the edge
+    };
+
+    /*!
+     * \brief The NodeSnapshot structure
+     * \details Copy of a node for debugging, neighbours are referenced by ids.
+     */
+    struct NodeSnapshot {
+        int id;
         int x;
         int y;
-        QVector<Node*> neighbours;
-        Node* parent;
+        QVector<int> neighbours;    ///< Ids of neighbouring nodes
+    };
+
+    /*!
+     * \brief The OpenEntry structure
+     * \details Node waiting in the open set of the A* search.
+     */
+    struct OpenEntry {
+        float globalGoal;
+        const Node* node;
+    };
+
+    /*!
+     * \brief The Workspace structure
+     * \details Search state of one query, every thread running queries uses its own workspace.
+     * Buffers keep their capacity between queries, so repeated queries on the same graph do not allocate.
+     */
+    struct Workspace {
+        const Node* nodeStart = nullptr;
+        const Node* nodeEnd = nullptr;
+        QVector<bool> visited;              ///< Search state of nodes (index is the node id), reset only for touched nodes
+        QVector<float> globalGoal;
+        QVector<float> localGoal;
+        QVector<int> parent;                ///< Edge the node was reached by (-1 if none)
+        QVector<int> touched;               ///< Ids of nodes reached by the last search
+        QVector<OpenEntry> open;            ///< Binary heap of the open set
+        QVector<std::tuple<int,int>> solution;
+        int expanded = 0;                   ///< Number of nodes expanded by the last search
+        int maxOpen = 0;                    ///< Largest size of the open set during the last search
     };
 
     /*!
@@ -49,23 +102,24 @@ public:
     explicit Pathfinding(QObject *parent = nullptr);
 
     /*!
-     * \brief loads points from map into nodes
+     * \brief loads points which have to be nodes of the graph (stations)
+     * \details other points of streets become nodes only if they are crossings or ends of streets
      * \param points
      */
     void loadPoints(const QVector<std::tuple<int,int>>& points);
 
     /*!
-     * \brief resets nodes
+     * \brief opens all streets
      */
-    void resetPoints();
+    void resetClosures();
 
     /*!
      * \brief loads paths
-     * \details loads paths (connections between nodes) from map and creates extra nodes in middle of each path, those extra points are also returned to the "points" variable
+     * \details loads paths (connections between points) of streets from map, chains of segments of one street
+     * going through points which are not nodes are contracted into single edges
      * \param streets
-     * \param points
      */
-    void loadPaths(QMap<QString, street>& streets, QVector<std::tuple<int,int>>& points);
+    void loadPaths(const QMap<QString, street>& streets);
 
     /*!
      * \brief loads a goal
@@ -75,37 +129,200 @@ public:
      */
     void loadGoal(std::tuple<int,int> start, std::tuple<int,int> end);
 
+    /*!
+     * \brief loads a goal into the given workspace
+     * \param start node coordinates
+     * \param end node coordinates
+     * \param workspace
+     */
+    void loadGoal(std::tuple<int,int> start, std::tuple<int,int> end, Workspace& workspace) const;
+
     /*!
      * \brief finds the route between start & end points
      * \return
      */
     bool solveAStar();
 
+    /*!
+     * \brief finds the fastest route between start & end points for a given departure time
+     * \details time-dependent variant, a path is weighted by traffic profiles at the time the route enters it
+     * \param departure departure time (seconds of the day)
+     * \param speed distance travelled in one second on a street with the traffic factor 1
+     * \return
+     */
+    bool solveAStar(double departure, double speed);
+
+    /*!
+     * \brief finds the route between start & end points loaded in the workspace
+     * \details does not modify the graph, can run concurrently with other queries using different workspaces
+     * \param workspace
+     * \return
+     */
+    bool solveAStar(Workspace& workspace) const;
+
+    /*!
+     * \brief time-dependent variant of solveAStar() using the given workspace
+     * \param departure departure time (seconds of the day)
+     * \param speed distance travelled in one second on a street with the traffic factor 1
+     * \param workspace
+     * \return
+     */
+    bool solveAStar(double departure, double speed, Workspace& workspace) const;
+
+    /*!
+     * \brief variant of solveAStar() weighting edges by their lengths multiplied by the given factors
+     * \details traffic factors and profiles are not used, closed edges are skipped
+     * \param factors factors of edges (index is the edge), at least 1
+     * \param workspace
+     * \return
+     */
+    bool solveAStar(const QVector<float>& factors, Workspace& workspace) const;
+
+    /*!
+     * \brief returns the weighted length of the solution calculated by solveAStar()
+     * \return INFINITY if the end was not reached
+     */
+    float getSolutionCost();
+
+    /*!
+     * \brief returns the weighted length of the solution stored in the workspace
+     * \param workspace
+     * \return INFINITY if the end was not reached
+     */
+    float getSolutionCost(const Workspace& workspace) const;
+
     /*!
      * \brief returns the solution calculated by solveAStart() method
      * \return
      */
     QVector<std::tuple<int,int>> getSolution();
 
+    /*!
+     * \brief returns the solution stored in the workspace
+     * \details the returned vector shares the buffer of the workspace, it should be released before the next query
+     * to let the workspace reuse the buffer
+     * \param workspace
+     * \return
+     */
+    QVector<std::tuple<int,int>> getSolution(const Workspace& workspace) const;
+
+    /*!
+     * \brief returns edges of the solution stored in the workspace
+     * \param workspace
+     * \return indexes of edges in the order of the route, empty if the end was not reached
+     */
+    QVector<int> getSolutionEdges(const Workspace& workspace) const;
+
     /*!
      * \brief debugging method used to return info about created graph
+     * \details the snapshot does not point into the graph, it stays valid after the graph changes or is destroyed
+     * \return nodes of the graph (index is the node id)
+     */
+    QVector<NodeSnapshot> returnGraph() const;
+
+    /*!
+     * \brief returns a read-only reference to nodes of the created graph
+     * \return nodes (index is the node id)
+     */
+    const QVector<Node>& getGraph() const;
+
+    /*!
+     * \brief returns a read-only reference to edges of the created graph
      * \return
      */
-    QMap<std::tuple<int,int>, Node> returnGraph();
+    const QVector<Edge>& getEdges() const;
+
+    /*!
+     * \brief returns indexes of edges of every street
+     * \return edges in both directions (key is the name of the street)
+     */
+    const QMap<QString, QVector<int>>& getStreetEdges() const;
+
+    /*!
+     * \brief returns id of the node in the given point
+     * \param point
+     * \return -1 if the point is not a node
+     */
+    int findNode(std::tuple<int,int> point) const;
+
+    /*!
+     * \brief returns the edge whose polyline goes through the given point
+     * \details only one direction of the chain is returned, the other one is stored next to it
+     * \param point
+     * \param position receives index of the point in the polyline of the edge
+     * \return index of the edge, -1 if the point is a node or does not lie on any street
+     */
+    int findEdge(std::tuple<int,int> point, int& position) const;
 
     /*!
-     * \brief sets/unsets node as an obstacle
-     * \param node's coordinates
-     * \param true if set node as obstacle, false if unset node as obstcle
+     * \brief closes/opens the street
+     * \param name name of the street
+     * \param closed true if the street is blocked
      * \return true if succeeds, otherwise false
      */
-    bool setNodeObstacle(std::tuple<int,int> point, bool obstacle);
+    bool setStreetClosed(const QString& name, bool closed);
+
+    /*!
+     * \brief sets traffic factor of the street
+     * \details a length of every edge of the street is multiplied by the factor
+     * \param name name of the street
+     * \param cost traffic factor (1 is free flow)
+     * \return true if succeeds, otherwise false
+     */
+    bool setStreetCost(const QString& name, float cost);
+
+    /*!
+     * \brief stores a traffic profile for time-dependent queries
+     * \param profile
+     * \return index of the profile used by setNodeProfile()
+     */
+    int addProfile(const TrafficProfile& profile);
+
+    /*!
+     * \brief sets traffic profile of the street
+     * \param name name of the street
+     * \param profile index returned by addProfile()
+     * \return true if succeeds, otherwise false
+     */
+    bool setStreetProfile(const QString& name, int profile);
+
+    /*!
+     * \brief returns true if any traffic profile was added
+     * \return
+     */
+    bool hasProfiles() const;
 
 private:
-    QMap<std::tuple<int,int>, Node> nodesMap;   ///< container for all nodes (key is nodes coordinates)
+    QVector<Node> nodes;                        ///< container for all nodes (index is the node id)
+    QMap<std::tuple<int,int>, int> nodeIndex;   ///< Node ids (key is nodes coordinates)
+    QVector<Edge> edges;
+    QMap<QString, QVector<int>> streetEdges;    ///< Edges of every street in both directions
+    QMap<std::tuple<int,int>, std::pair<int,int>> edgePoints;  ///< Edge and position in its polyline of points which are not nodes
     int nodeNum = 0;
-    Node *nodeStart = nullptr;
-    Node *nodeEnd = nullptr;
+    Workspace workspace;                        ///< Workspace used by queries without an explicit workspace
+    QVector<TrafficProfile> profiles;
+
+    /*!
+     * \brief adds a node into the graph
+     * \param point
+     * \return id of the node
+     */
+    int addNode(std::tuple<int,int> point);
+
+    /*!
+     * \brief A* search with the given weight of an edge
+     * \param weight returns weight of the edge from the given local goal of its first node
+     * \param workspace
+     * \return
+     */
+    template<typename Weight>
+    bool search(Weight weight, Workspace& workspace) const;
+
+    /*!
+     * \brief stores the route found by the last search into the solution of the workspace
+     * \param workspace
+     */
+    void buildSolution(Workspace& workspace) const;
 
 };
 
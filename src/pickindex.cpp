@@ -0,0 +1,111 @@
+/*!
+ * @file pickindex.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Finding selectable items under the cursor
+ */
+
+#include "pickindex.h"
+
+PickIndex::PickIndex(double cellSize) : cellSize(cellSize), stopGrid(cellSize), pieceGrid(cellSize) {}
+
+
+void PickIndex::clear()
+{
+    stops.clear();
+    buses.clear();
+    segments.clear();
+    pieces.clear();
+    stopReach = 0;
+    busReach = 0;
+}
+
+
+double PickIndex::reach(QGraphicsItem *item)
+{
+    auto rect = item->sceneBoundingRect();
+    auto pos = item->scenePos();
+    return std::max({pos.x() - rect.left(), rect.right() - pos.x(), pos.y() - rect.top(), rect.bottom() - pos.y()});
+}
+
+
+void PickIndex::addStop(int key, QGraphicsItem *item)
+{
+    stops.push_back(Target {key, item});
+    stopReach = std::max(stopReach, reach(item));
+}
+
+
+void PickIndex::addStreet(int key, const QVector<std::tuple<int,int,int,int>>& lines)
+{
+    for (const auto& line : lines)
+    {
+        Segment s {key, double(std::get<0>(line)), double(std::get<1>(line)), double(std::get<2>(line)), double(std::get<3>(line))};
+
+        // pieces are at most one cell long, so a piece near the cursor lies in a neighbouring cell
+        auto length = std::hypot(s.x2 - s.x1, s.y2 - s.y1);
+        auto count = std::max(1, int(std::ceil(length / cellSize)));
+        for (int i = 0; i < count; ++i)
+        {
+            auto t = (i + 0.5) / count;
+            pieces.push_back(std::make_pair(QPointF(s.x1 + (s.x2 - s.x1) * t, s.y1 + (s.y2 - s.y1) * t), segments.size()));
+        }
+        segments.push_back(s);
+    }
+}
+
+
+void PickIndex::addBus(int key, QGraphicsItem *item)
+{
+    buses.push_back(Target {key, item});
+    busReach = std::max(busReach, reach(item));
+}
+
+
+void PickIndex::build(const QRectF& bounds)
+{
+    stopGrid.build(bounds, stops.size(), [this](int i) {return stops[i].item->scenePos();});
+    pieceGrid.build(bounds, pieces.size(), [this](int i) {return pieces[i].first;});
+}
+
+
+int PickIndex::pickTarget(const QPointF& pos, const QVector<Target>& targets, const SpatialGrid& grid, double reach)
+{
+    // the item added last is drawn on top
+    auto picked = -1;
+    grid.query(QRectF(pos.x() - reach, pos.y() - reach, 2 * reach, 2 * reach), [&](int i) {
+        if (i >= targets.size() or i <= picked) return;
+
+        auto item = targets[i].item;
+        if (item->isVisible() and item->sceneBoundingRect().contains(pos)) picked = i;
+    });
+    return picked < 0 ? -1 : targets[picked].key;
+}
+
+
+int PickIndex::pick(const QPointF& pos, double tolerance, const SpatialGrid& busItems) const
+{
+    auto key = pickTarget(pos, buses, busItems, busReach);
+    if (key >= 0) return key;
+
+    key = pickTarget(pos, stops, stopGrid, stopReach);
+    if (key >= 0) return key;
+
+    // the nearest segment within the tolerance
+    auto nearest = tolerance;
+    auto reach = cellSize / 2 + tolerance;
+    pieceGrid.query(QRectF(pos.x() - reach, pos.y() - reach, 2 * reach, 2 * reach), [&](int i) {
+        const auto& s = segments[pieces[i].second];
+        auto dx = s.x2 - s.x1;
+        auto dy = s.y2 - s.y1;
+        auto squared = dx * dx + dy * dy;
+        auto t = squared > 0 ? std::min(1.0, std::max(0.0, ((pos.x() - s.x1) * dx + (pos.y() - s.y1) * dy) / squared)) : 0.0;
+        auto distance = std::hypot(pos.x() - s.x1 - dx * t, pos.y() - s.y1 - dy * t);
+        if (distance <= nearest)
+        {
+            nearest = distance;
+            key = s.key;
+        }
+    });
+    return key;
+}
@@ -0,0 +1,123 @@
+/*!
+ * @file pickindex.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of finding selectable items under the cursor
+ */
+
+#ifndef PICKINDEX_H
+#define PICKINDEX_H
+
+#include <QGraphicsItem>
+#include <QRectF>
+#include <QPointF>
+#include <QVector>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+
+#include "spatialgrid.h"
+
+/*!
+ * \brief Finds the selectable item under the cursor without hit-testing all items of the scene
+ * \details Stops and segments of streets are sorted into grids once, long segments are split into pieces
+ * of a cell. Buses are looked up in the grid of their items, which the scene updates when an item moves. Only
+ * items near the cursor are tested. Buses are above stops and stops are above streets, as in the scene.
+ */
+class PickIndex
+{
+public:
+    /*!
+     * \brief constructor
+     * \param cellSize length of a side of a cell and the longest piece of a segment
+     */
+    explicit PickIndex(double cellSize = 64);
+
+    /*!
+     * \brief removes all items
+     */
+    void clear();
+
+    /*!
+     * \brief adds an item of a stop
+     * \param key key of the item in the registry of rendered items
+     * \param item
+     */
+    void addStop(int key, QGraphicsItem *item);
+
+    /*!
+     * \brief adds segments of a street
+     * \param key key of the item in the registry of rendered items
+     * \param lines segments (x1, y1, x2, y2) of the street
+     */
+    void addStreet(int key, const QVector<std::tuple<int,int,int,int>>& lines);
+
+    /*!
+     * \brief adds an item of a bus, buses are added in the order of their keys
+     * \param key key of the item in the registry of rendered items
+     * \param item
+     */
+    void addBus(int key, QGraphicsItem *item);
+
+    /*!
+     * \brief sorts stops and segments into grids
+     * \param bounds area of the scene
+     */
+    void build(const QRectF& bounds);
+
+    /*!
+     * \brief finds the topmost item at the position
+     * \param pos position in the scene
+     * \param tolerance distance from a segment of a street which still hits it
+     * \param busItems grid of positions of items of buses (index is the bus key)
+     * \return key of the item in the registry of rendered items, -1 if there is none
+     */
+    int pick(const QPointF& pos, double tolerance, const SpatialGrid& busItems) const;
+
+private:
+    /*!
+     * \brief The Target struct
+     * \details Item tested by its bounding rectangle.
+     */
+    struct Target {
+        int key;
+        QGraphicsItem *item;
+    };
+
+    /*!
+     * \brief The Segment struct
+     */
+    struct Segment {
+        int key;
+        double x1, y1, x2, y2;
+    };
+
+    double cellSize;
+    QVector<Target> stops;
+    QVector<Target> buses;                  ///< Index is the bus key
+    QVector<Segment> segments;
+    QVector<std::pair<QPointF, int>> pieces; ///< Middles of pieces of segments and indexes of their segments
+    SpatialGrid stopGrid;
+    SpatialGrid pieceGrid;
+    double stopReach = 0;                   ///< Largest distance from the position of a stop to the edge of its item
+    double busReach = 0;                    ///< Largest distance from the position of a bus to the edge of its item
+
+    /*!
+     * \brief returns the largest distance from the position of the item to the edge of its bounding rectangle
+     * \param item
+     * \return
+     */
+    static double reach(QGraphicsItem *item);
+
+    /*!
+     * \brief returns the key of the topmost item of the targets containing the position
+     * \param pos
+     * \param targets
+     * \param grid grid of targets
+     * \param reach largest reach of targets
+     * \return -1 if there is none
+     */
+    static int pickTarget(const QPointF& pos, const QVector<Target>& targets, const SpatialGrid& grid, double reach);
+};
+
+#endif // PICKINDEX_H
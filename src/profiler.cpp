@@ -0,0 +1,209 @@
+/*!
+ * @file profiler.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Per-tick profiler
+ */
+
+#include "profiler.h"
+
+RollingHistogram::RollingHistogram(double base, int window) : samples(window, 0.0), buckets(bucketCount, 0), base(base) {}
+
+
+void RollingHistogram::push(double value)
+{
+    if (count == samples.size()) {
+        --buckets[bucket(samples[next])];
+        sum -= samples[next];
+    } else {
+        ++count;
+    }
+
+    samples[next] = value;
+    ++buckets[bucket(value)];
+    sum += value;
+    next = (next + 1) % samples.size();
+}
+
+
+double RollingHistogram::percentile(double p) const
+{
+    if (count == 0) return 0.0;
+
+    auto rank = std::max(1, int(std::ceil(count * p / 100.0)));
+    auto seen = 0;
+    for (int i = 0; i < bucketCount; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank) return std::min(base * std::pow(2.0, i), max());
+    }
+    return max();
+}
+
+
+double RollingHistogram::mean() const
+{
+    return count == 0 ? 0.0 : sum / count;
+}
+
+
+double RollingHistogram::max() const
+{
+    if (count == 0) return 0.0;
+    return *std::max_element(samples.begin(), samples.begin() + count);
+}
+
+
+int RollingHistogram::size() const
+{
+    return count;
+}
+
+
+int RollingHistogram::bucket(double value) const
+{
+    auto i = 0;
+    for (auto bound = base; value > bound and i < bucketCount - 1; bound *= 2)
+        ++i;
+    return i;
+}
+
+
+Profiler::Profiler() : ticks(tickWindow), phaseHistograms(PhaseCount), counterHistograms(CounterCount, RollingHistogram(1.0))
+{
+    for (auto& value : phaseTime)
+        value = 0;
+    for (auto& value : counterValue)
+        value = 0;
+
+    clock.start();
+}
+
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+
+void Profiler::addTime(Phase phase, qint64 nsecs)
+{
+    phaseTime[phase].fetch_add(nsecs, std::memory_order_relaxed);
+}
+
+
+void Profiler::count(Counter counter, qint64 value)
+{
+    counterValue[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+
+void Profiler::endTick()
+{
+    auto& tick = ticks[tickNumber % tickWindow];
+    tick.number = tickNumber++;
+    tick.at = clock.elapsed();
+
+    auto total = 0.0;
+    for (int i = 0; i < PhaseCount; ++i)
+    {
+        tick.phases[i] = phaseTime[i].exchange(0, std::memory_order_relaxed) / 1e6;
+        phaseHistograms[i].push(tick.phases[i]);
+        if (i != Routing) total += tick.phases[i];
+    }
+    tickHistogram.push(total);
+
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        tick.counters[i] = counterValue[i].exchange(0, std::memory_order_relaxed);
+        counterHistograms[i].push(tick.counters[i]);
+    }
+}
+
+
+QString Profiler::summary() const
+{
+    auto row = [](QString name, const RollingHistogram& histogram, QString unit) {
+        return QString("%1 p50 %2  p95 %3  max %4 %5\n").arg(name.leftJustified(16))
+            .arg(histogram.percentile(50), 0, 'f', 2).arg(histogram.percentile(95), 0, 'f', 2).arg(histogram.max(), 0, 'f', 2).arg(unit);
+    };
+
+    QString result = row("tick", tickHistogram, "ms");
+    for (int i = 0; i < PhaseCount; ++i)
+        result += row(phaseName(Phase(i)), phaseHistograms[i], "ms");
+
+    // route queries during the last second
+    qint64 queries = 0;
+    if (tickNumber > 0)
+    {
+        const auto& last = ticks[(tickNumber - 1) % tickWindow];
+        for (qint64 n = tickNumber - 1; n >= 0 and n > tickNumber - 1 - tickWindow; --n)
+        {
+            const auto& tick = ticks[n % tickWindow];
+            if (last.at - tick.at >= 1000) break;
+            queries += tick.counters[RouteQueries];
+        }
+    }
+    result += QString("%1 %2\n").arg(QString("route queries/s").leftJustified(16)).arg(queries);
+
+    for (int i = NodesExpanded; i < CounterCount; ++i)
+        result += row(counterName(Counter(i)), counterHistograms[i], "/tick");
+
+    return result.trimmed();
+}
+
+
+bool Profiler::dumpCsv(QString path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    out << "tick,time_ms";
+    for (int i = 0; i < PhaseCount; ++i)
+        out << "," << phaseName(Phase(i)).replace(' ', '_') << "_ms";
+    for (int i = 0; i < CounterCount; ++i)
+        out << "," << counterName(Counter(i)).replace(' ', '_');
+    out << "\n";
+
+    for (qint64 n = std::max<qint64>(0, tickNumber - tickWindow); n < tickNumber; ++n)
+    {
+        const auto& tick = ticks[n % tickWindow];
+        out << tick.number << "," << tick.at;
+        for (int i = 0; i < PhaseCount; ++i)
+            out << "," << QString::number(tick.phases[i], 'f', 4);
+        for (int i = 0; i < CounterCount; ++i)
+            out << "," << tick.counters[i];
+        out << "\n";
+    }
+
+    return true;
+}
+
+
+QString Profiler::phaseName(Phase phase)
+{
+    switch (phase) {
+        case Simulate:   return "simulate";
+        case UpdateTime: return "update time";
+        case Routing:    return "routing";
+        case Paint:      return "paint";
+        case Pick:       return "pick";
+        default:         return "";
+    }
+}
+
+
+QString Profiler::counterName(Counter counter)
+{
+    switch (counter) {
+        case RouteQueries:   return "route queries";
+        case NodesExpanded:  return "nodes expanded";
+        case LegCacheHits:   return "leg cache hits";
+        case ItemsRepainted: return "items repainted";
+        case ItemsMoved:     return "items moved";
+        case AreaRepainted:  return "area repainted";
+        default:             return "";
+    }
+}
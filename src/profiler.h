@@ -0,0 +1,199 @@
+/*!
+ * @file profiler.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the per-tick profiler
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+/*!
+ * Instrumentation is compiled only with "qmake CONFIG+=profiling" (defines ICP_PROFILING),
+ * otherwise the macros expand to nothing.
+ */
+#ifdef ICP_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) Profiler::ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(phase)
+#define PROFILE_COUNT(counter, value) Profiler::instance().count(counter, value)
+#define PROFILE_TICK() Profiler::instance().endTick()
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_COUNT(counter, value)
+#define PROFILE_TICK()
+#endif
+
+/*!
+ * \brief The RollingHistogram class
+ * \details Histogram of the last samples, upper bounds of buckets grow by a factor of two from the base value.
+ */
+class RollingHistogram
+{
+public:
+    static const int bucketCount = 24;
+
+    /*!
+     * \brief constructor
+     * \param base upper bound of the first bucket
+     * \param window number of samples kept in the histogram
+     */
+    explicit RollingHistogram(double base = 0.001, int window = 256);
+
+    /*!
+     * \brief adds a sample, the oldest sample is removed when the window is full
+     * \param value
+     */
+    void push(double value);
+
+    /*!
+     * \brief returns the upper bound of the bucket containing the given percentile
+     * \param p percentile (0 - 100)
+     * \return
+     */
+    double percentile(double p) const;
+
+    double mean() const;
+    double max() const;
+
+    /*!
+     * \brief returns the number of samples in the histogram
+     * \return
+     */
+    int size() const;
+
+private:
+    QVector<double> samples;    ///< Ring buffer of samples
+    QVector<int> buckets;
+    double base;
+    int next = 0;
+    int count = 0;
+    double sum = 0.0;
+
+    int bucket(double value) const;
+};
+
+/*!
+ * \brief Collects time spent in phases of the simulation and counters of the work done during every tick.
+ * \details Phases and counters may be recorded from any thread, endTick() and readers are called from the GUI thread.
+ */
+class Profiler
+{
+public:
+#ifdef ICP_PROFILING
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    enum Phase {
+        Simulate,
+        UpdateTime,
+        Routing,        ///< Route queries, summed over all threads
+        Paint,
+        Pick,           ///< Finding the item under the cursor on a click
+        PhaseCount
+    };
+
+    enum Counter {
+        RouteQueries,
+        NodesExpanded,
+        LegCacheHits,   ///< Route queries answered by the cache of legs of lines
+        ItemsRepainted,
+        ItemsMoved,     ///< Buses whose item moved by at least one pixel of the view
+        AreaRepainted,  ///< Area of the view repainted in the tick (pixels)
+        CounterCount
+    };
+
+    /*!
+     * \brief The ScopedTimer class
+     * \details Adds the time between construction and destruction to the phase.
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Phase phase) : phase(phase) { timer.start(); }
+        ~ScopedTimer() { Profiler::instance().addTime(phase, timer.nsecsElapsed()); }
+    private:
+        Phase phase;
+        QElapsedTimer timer;
+    };
+
+    /*!
+     * \brief returns the profiler of the application
+     * \return
+     */
+    static Profiler& instance();
+
+    /*!
+     * \brief adds time to the phase of the current tick
+     * \param phase
+     * \param nsecs nanoseconds
+     */
+    void addTime(Phase phase, qint64 nsecs);
+
+    /*!
+     * \brief adds a value to the counter of the current tick
+     * \param counter
+     * \param value
+     */
+    void count(Counter counter, qint64 value = 1);
+
+    /*!
+     * \brief closes the current tick and adds its values into the histograms
+     */
+    void endTick();
+
+    /*!
+     * \brief formats percentiles of the last ticks
+     * \return text of the overlay
+     */
+    QString summary() const;
+
+    /*!
+     * \brief writes the recorded ticks into a CSV file
+     * \param path
+     * \return true if the file was written, otherwise false
+     */
+    bool dumpCsv(QString path) const;
+
+    static QString phaseName(Phase phase);
+    static QString counterName(Counter counter);
+
+private:
+    Profiler();
+
+    /*!
+     * \brief The Tick structure
+     * \details Values recorded during one tick.
+     */
+    struct Tick {
+        qint64 number;
+        qint64 at;                          ///< Milliseconds since the start of the profiler
+        double phases[PhaseCount];          ///< Milliseconds
+        qint64 counters[CounterCount];
+    };
+
+    static const int tickWindow = 1024;     ///< Number of ticks kept for the CSV dump
+
+    std::atomic<qint64> phaseTime[PhaseCount];
+    std::atomic<qint64> counterValue[CounterCount];
+
+    QElapsedTimer clock;
+    qint64 tickNumber = 0;
+    QVector<Tick> ticks;                    ///< Ring buffer of the last ticks
+    RollingHistogram tickHistogram;         ///< Sum of all phases except routing (which is nested in the simulation)
+    QVector<RollingHistogram> phaseHistograms;
+    QVector<RollingHistogram> counterHistograms;
+};
+
+#endif // PROFILER_H
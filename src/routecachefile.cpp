@@ -0,0 +1,244 @@
+/*!
+ * @file routecachefile.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Persistent cache of routes
+ */
+
+#include "routecachefile.h"
+
+static const char magic[] = "ICPR";
+static const quint32 version = 1;
+
+// smallest sizes of records in bytes
+static const int pointSize = 8;         // x, y
+static const int edgeSize = 4;          // index of the edge
+static const int routeSize = 12;        // length, counts of points and edges
+static const int alternativeSize = 20;  // key of the leg, count of routes
+static const int legSize = 24;          // key of the leg, counts of points and edges
+
+
+/*!
+ * \brief checks whether the records still fit into the rest of the stream
+ * \param in
+ * \param count number of records
+ * \param recordSize smallest size of one record in bytes
+ * \return
+ */
+static bool fits(QDataStream& in, quint32 count, int recordSize)
+{
+    auto device = in.device();
+    return quint64(count) <= quint64(device->size() - device->pos()) / recordSize;
+}
+
+
+RouteCacheFile::RouteCacheFile(QString directory) : directory(directory) {}
+
+
+bool RouteCacheFile::isEnabled() const
+{
+    return !directory.isEmpty();
+}
+
+
+QByteArray RouteCacheFile::key(const QByteArray& map, QStringList closed, bool trafficRouting)
+{
+    std::sort(closed.begin(), closed.end());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(map);
+    for (const auto& name : closed)
+    {
+        hash.addData(name.toUtf8());
+        hash.addData("\n", 1);
+    }
+    hash.addData(trafficRouting ? "traffic" : "length", trafficRouting ? 7 : 6);
+    return hash.result().toHex();
+}
+
+
+QString RouteCacheFile::filePath(const QByteArray& key) const
+{
+    return QDir(directory).filePath(QString::fromLatin1(key) + ".routes");
+}
+
+
+void RouteCacheFile::writeRoute(QDataStream& out, const QVector<std::tuple<int,int>>& points, const QVector<int>& edges)
+{
+    out << quint32(points.size());
+    for (const auto& point : points)
+    {
+        out << qint32(std::get<0>(point)) << qint32(std::get<1>(point));
+    }
+    out << quint32(edges.size());
+    for (const auto e : edges)
+    {
+        out << qint32(e);
+    }
+}
+
+
+bool RouteCacheFile::readRoute(QDataStream& in, int edgeCount, QVector<std::tuple<int,int>>& points, QVector<int>& edges)
+{
+    // counts are checked against the rest of the file before anything is allocated
+    quint32 count;
+    in >> count;
+    if (!fits(in, count, pointSize)) return false;
+
+    points.resize(count);
+    for (auto& point : points)
+    {
+        qint32 x, y;
+        in >> x >> y;
+        point = std::tuple<int,int>(x, y);
+    }
+
+    in >> count;
+    if (!fits(in, count, edgeSize)) return false;
+
+    edges.resize(count);
+    for (auto& e : edges)
+    {
+        qint32 index;
+        in >> index;
+        if (index < 0 or index >= edgeCount) return false;
+        e = index;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+
+bool RouteCacheFile::load(const QByteArray& key, const Pathfinding& graph, AlternativeRoutes& alternatives, LegCache& legs) const
+{
+    if (!isEnabled()) return false;
+
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    auto size = file.size();
+    auto data = file.map(0, size);
+    if (!data) return false;
+
+    QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size)));
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    const auto edgeCount = graph.getEdges().size();
+    typedef std::tuple<int,int,int,int> LegKey;
+    QVector<std::pair<LegKey, QVector<AlternativeRoutes::Route>>> routes;
+    QVector<std::pair<LegKey, LegCache::Leg>> cached;
+
+    auto readKey = [&in]() {
+        qint32 x1, y1, x2, y2;
+        in >> x1 >> y1 >> x2 >> y2;
+        return LegKey(x1, y1, x2, y2);
+    };
+
+    // everything is parsed before the routes are used, a damaged or outdated file changes nothing
+    auto parse = [&]() {
+        char header[4];
+        if (in.readRawData(header, 4) != 4 or memcmp(header, magic, 4) != 0) return false;
+
+        quint32 fileVersion, keySize, nodes, edges, count;
+        in >> fileVersion >> keySize;
+        if (fileVersion != version or keySize != quint32(key.size())) return false;
+
+        QByteArray fileKey(keySize, '\0');
+        if (in.readRawData(fileKey.data(), keySize) != int(keySize) or fileKey != key) return false;
+
+        in >> nodes >> edges;
+        if (nodes != quint32(graph.getGraph().size()) or edges != quint32(edgeCount)) return false;
+
+        in >> count;
+        if (!fits(in, count, alternativeSize)) return false;
+        for (quint32 i = 0; i < count; ++i)
+        {
+            auto leg = readKey();
+            quint32 alternativeCount;
+            in >> alternativeCount;
+            if (!fits(in, alternativeCount, routeSize)) return false;
+
+            QVector<AlternativeRoutes::Route> alternative(alternativeCount);
+            for (auto& route : alternative)
+            {
+                in >> route.length;
+                if (!readRoute(in, edgeCount, route.points, route.edges)) return false;
+            }
+            routes.push_back(std::make_pair(leg, alternative));
+        }
+
+        in >> count;
+        if (!fits(in, count, legSize)) return false;
+        for (quint32 i = 0; i < count; ++i)
+        {
+            auto leg = readKey();
+            LegCache::Leg route;
+            if (!readRoute(in, edgeCount, route.route, route.edges)) return false;
+            cached.push_back(std::make_pair(leg, route));
+        }
+
+        return in.status() == QDataStream::Ok and in.atEnd();
+    };
+
+    auto valid = parse();
+    file.unmap(data);
+    if (!valid) return false;
+
+    auto epoch = legs.getEpoch();
+    for (const auto& leg : routes)
+    {
+        const auto& k = leg.first;
+        alternatives.insert(std::tuple<int,int>(std::get<0>(k), std::get<1>(k)), std::tuple<int,int>(std::get<2>(k), std::get<3>(k)), leg.second);
+    }
+    for (const auto& leg : cached)
+    {
+        const auto& k = leg.first;
+        legs.insert(std::tuple<int,int>(std::get<0>(k), std::get<1>(k)), std::tuple<int,int>(std::get<2>(k), std::get<3>(k)), leg.second.route, leg.second.edges, epoch);
+    }
+    return true;
+}
+
+
+bool RouteCacheFile::save(const QByteArray& key, const Pathfinding& graph, const AlternativeRoutes& alternatives, LegCache& legs) const
+{
+    if (!isEnabled() or !QDir().mkpath(directory)) return false;
+
+    QSaveFile file(filePath(key));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    auto writeKey = [&out](const std::tuple<int,int,int,int>& leg) {
+        out << qint32(std::get<0>(leg)) << qint32(std::get<1>(leg)) << qint32(std::get<2>(leg)) << qint32(std::get<3>(leg));
+    };
+
+    out.writeRawData(magic, 4);
+    out << version << quint32(key.size());
+    out.writeRawData(key.constData(), key.size());
+    out << quint32(graph.getGraph().size()) << quint32(graph.getEdges().size());
+
+    const auto& routes = alternatives.getLegs();
+    out << quint32(routes.size());
+    for (auto it = routes.begin(); it != routes.end(); ++it)
+    {
+        writeKey(it.key());
+        out << quint32(it.value().size());
+        for (const auto& route : it.value())
+        {
+            out << route.length;
+            writeRoute(out, route.points, route.edges);
+        }
+    }
+
+    const auto cached = legs.getLegs();
+    out << quint32(cached.size());
+    for (auto it = cached.begin(); it != cached.end(); ++it)
+    {
+        writeKey(it.key());
+        writeRoute(out, it.value().route, it.value().edges);
+    }
+
+    return out.status() == QDataStream::Ok and file.commit();
+}
@@ -0,0 +1,94 @@
+/*!
+ * @file routecachefile.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the persistent cache of routes
+ */
+
+#ifndef ROUTECACHEFILE_H
+#define ROUTECACHEFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <tuple>
+#include <cstring>
+
+#include "pathfinding.h"
+#include "alternativeroutes.h"
+#include "legcache.h"
+
+/*!
+ * \brief Routes of a map stored on the disk between runs
+ * \details A file holds alternative routes and cached legs of one map, its name is derived from a hash of the map file
+ * and the state of closures. The file is parsed from a memory mapping into temporary containers and the whole file is
+ * validated (header, size of the graph, counts of records against the rest of the file, indexes of edges) before
+ * anything is loaded, an invalid file is ignored and routes are searched again. Files are replaced atomically, so an
+ * interrupted run never leaves a damaged file behind.
+ */
+class RouteCacheFile
+{
+public:
+    /*!
+     * \brief constructor
+     * \param directory directory with cache files, the cache is disabled if it is empty
+     */
+    explicit RouteCacheFile(QString directory = QString());
+
+    /*!
+     * \brief returns true if a directory was given
+     * \return
+     */
+    bool isEnabled() const;
+
+    /*!
+     * \brief computes the key of routes of the map
+     * \param map hash of the map file
+     * \param closed names of blocked streets
+     * \param trafficRouting true if routes go around traffic
+     * \return
+     */
+    static QByteArray key(const QByteArray& map, QStringList closed, bool trafficRouting);
+
+    /*!
+     * \brief returns the path of the file with the given key
+     * \param key
+     * \return
+     */
+    QString filePath(const QByteArray& key) const;
+
+    /*!
+     * \brief loads routes from the file with the given key
+     * \details nothing is loaded unless the whole file is valid for the graph
+     * \param key
+     * \param graph graph the routes were computed on
+     * \param alternatives receives alternative routes
+     * \param legs receives cached legs
+     * \return true if the file was loaded
+     */
+    bool load(const QByteArray& key, const Pathfinding& graph, AlternativeRoutes& alternatives, LegCache& legs) const;
+
+    /*!
+     * \brief saves routes into the file with the given key
+     * \param key
+     * \param graph graph the routes were computed on
+     * \param alternatives
+     * \param legs
+     * \return true if the file was written
+     */
+    bool save(const QByteArray& key, const Pathfinding& graph, const AlternativeRoutes& alternatives, LegCache& legs) const;
+
+private:
+    QString directory;
+
+    static void writeRoute(QDataStream& out, const QVector<std::tuple<int,int>>& points, const QVector<int>& edges);
+    static bool readRoute(QDataStream& in, int edgeCount, QVector<std::tuple<int,int>>& points, QVector<int>& edges);
+};
+
+#endif // ROUTECACHEFILE_H
@@ -10,27 +10,27 @@
 Scene::Scene(QObject *parent, QString path, int interval) : QGraphicsScene(parent)
 {
     interval_ms = interval;
-    // JSON file to JSON object
-    QFile file(path);
-    file.open(QIODevice::ReadOnly);
-    QByteArray rawData = file.readAll();
-    QJsonDocument doc(QJsonDocument::fromJson(rawData));
-    json = doc.object();
+    tickInterval = interval;
 
-    loadAll();
-    renderStreets();
-    renderStops();
-    renderVehicles();
+    // without a path the map is loaded later, usually by a MapLoader
+    if (!path.isNull())
+    {
+        loadModel(path);
+        createItems();
+    }
 
-    timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(simulate()));
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateTime()));
-    timer->start(interval_ms);
+    frameTimer = new QTimer(this);
+    connect(frameTimer, SIGNAL(timeout()), this, SLOT(renderFrame()));
+    connect(frameTimer, SIGNAL(timeout()), this, SLOT(profileTick()));
+    frameTimer->start(16);
 }
 
 
 Scene::~Scene()
 {
+    simulationThread.quit();
+    simulationThread.wait();
+
     for (auto &bus : buses)
     {
         if (bus.renderedItem)
@@ -57,19 +57,56 @@ Scene::~Scene()
 }
 
 
-QMap<int, bus> Scene::getBuses()
+bool Scene::loadModel(QString path, std::function<void(int)> progress, const std::atomic<bool> *cancelled)
+{
+    TRACE_SPAN("load map");
+    auto stage = [&progress, cancelled](int stage) {
+        if (cancelled and cancelled->load()) return false;
+        if (progress) progress(stage);
+        return true;
+    };
+
+    if (!stage(Parsing)) return false;
+
+    // JSON file to JSON object
+    QFile file(path);
+    file.open(QIODevice::ReadOnly);
+    QByteArray rawData = file.readAll();
+    QJsonDocument doc(QJsonDocument::fromJson(rawData));
+    json = doc.object();
+    mapDigest = QCryptographicHash::hash(rawData, QCryptographicHash::Sha1);
+
+    return loadAll(stage, cancelled);
+}
+
+
+void Scene::createItems()
+{
+    TRACE_SPAN("create items");
+    publishFrame();
+    frames.update();
+    renderLines();
+    renderStreets();
+    renderStops();
+    renderVehicles();
+    pickIndex.build(sceneRect());
+    itemGrid.build(mapBounds, buses.size(), [this](int key) {return buses.at(key).renderedItem->pos();});
+}
+
+
+const QVector<bus>& Scene::getBuses() const
 {
     return buses;
 }
 
 
-QMap<int, line> Scene::getLines()
+const QMap<int, line>& Scene::getLines() const
 {
     return lines;
 }
 
 
-QMap<QString, street> Scene::getStreets()
+const QMap<QString, street>& Scene::getStreets() const
 {
     return streets;
 }
@@ -77,6 +114,8 @@ QMap<QString, street> Scene::getStreets()
 
 void Scene::updateTime()
 {
+    PROFILE_SCOPE(Profiler::UpdateTime);
+    TRACE_SPAN("update time");
     static QString val;
     if (speed != 0) {
         countTime += interval_ms;
@@ -101,6 +140,7 @@ void Scene::updateTime()
                     }
                 }
             }
+            updateTrafficProfiles();
             val = QString::number(hours).rightJustified(2, '0') + QString(":") +
                   QString::number(minutes).rightJustified(2, '0') + QString(":") +
                   QString::number(seconds).rightJustified(2, '0');
@@ -112,49 +152,622 @@ void Scene::updateTime()
 
 void Scene::resetTime()
 {
+    post(command(command::Reset));
+}
+
+
+void Scene::resetModel()
+{
+    TRACE_SPAN("reset time");
     countTime = 0;
     hours = 0;
     minutes = 0;
     seconds = 0;
+    updateTrafficProfiles();
     resetVehicles();
+    routeLines(true);
+    emit timeValueChanged("00:00:00");
+}
+
+
+bool Scene::routeLines(bool assignPath, const std::atomic<bool> *cancelled)
+{
+    if (!routeBuses(false, assignPath, cancelled)) return false;
+
+    QMap<int, QVector<std::tuple<int,int,int,int>>> forward;
+    for (const auto& line : lines)
+        forward.insert(line.no, line.pathLines);
+
+    if (!routeBuses(true, false, cancelled)) return false;
+
+    // both directions are rendered (may have different route)
+    for (auto& line : lines)
+        line.pathLines = forward.value(line.no) + line.pathLines;
+    return true;
+}
+
+
+int Scene::getTime()
+{
+    return hours*3600 + minutes*60 + seconds;
+}
+
+
+bool Scene::isRunning() const
+{
+    return running;
+}
+
+
+void Scene::play()
+{
+    if (!worker) {
+        worker = new SimulationWorker([this]() {
+            bool redraw;
+            {
+                QMutexLocker locker(&modelMutex);
+                redraw = applyCommands();
+                simulate();
+                updateTime();
+                publishFrame();
+            }
+            if (redraw) QMetaObject::invokeMethod(this, "redrawLines", Qt::QueuedConnection);
+        });
+        worker->moveToThread(&simulationThread);
+        connect(&simulationThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+        simulationThread.start();
+    }
+    running = true;
+    QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection, Q_ARG(int, tickInterval));
+}
+
+
+void Scene::pause()
+{
+    running = false;
+    if (worker) QMetaObject::invokeMethod(worker, "stop", Qt::QueuedConnection);
+}
+
+
+void Scene::setInterval(int interval)
+{
+    tickInterval = interval;
+    if (worker) QMetaObject::invokeMethod(worker, "setInterval", Qt::QueuedConnection, Q_ARG(int, interval));
+}
+
+
+void Scene::step()
+{
+    post(command(command::Step));
+}
+
+
+void Scene::skip(int ms)
+{
+    command c(command::Skip);
+    c.value = ms;
+    post(c);
+}
+
+
+void Scene::rewind(int seconds)
+{
+    command c(command::Rewind);
+    c.value = seconds;
+    post(c);
+}
+
+
+void Scene::post(command c)
+{
+    c.sequence = commandSequence.fetch_add(1, std::memory_order_relaxed);
+    if (commands.post(c)) runCommands();
+}
+
+
+void Scene::post(QVector<command> batch)
+{
+    auto sequence = commandSequence.fetch_add(batch.size(), std::memory_order_relaxed);
+    for (auto& c : batch)
+    {
+        c.sequence = sequence++;
+    }
+    if (commands.post(batch)) runCommands();
+}
+
+
+QVector<command> Scene::getCommandLog()
+{
+    QMutexLocker locker(&modelMutex);
+    return commandLog;
+}
+
+
+void Scene::replay(const QVector<command>& log)
+{
+    auto batch = log;
+    for (auto& c : batch)
+    {
+        c.at = c.appliedAt;
+        c.appliedAt = -1;
+    }
+    post(batch);
+}
+
+
+void Scene::runCommands()
+{
+    auto run = [this]() {
+        bool redraw;
+        {
+            QMutexLocker locker(&modelMutex);
+            redraw = applyCommands();
+            publishFrame();
+        }
+        return redraw;
+    };
+
+    if (!worker) {
+        if (run()) redrawLines();
+        return;
+    }
+
+    // the queue was empty, so the worker may be paused and would not take the command at the next tick
+    QMetaObject::invokeMethod(worker, [this, run]() {
+        if (run()) QMetaObject::invokeMethod(this, "redrawLines", Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+
+bool Scene::laterCommand(const command& a, const command& b)
+{
+    return a.at != b.at ? a.at > b.at : a.sequence > b.sequence;
+}
 
+
+int Scene::getTimeMs() const
+{
+    return (hours*3600 + minutes*60 + seconds)*1000 + countTime;
+}
+
+
+bool Scene::applyCommands()
+{
+    auto now = getTimeMs();
+    for (auto& c : commands.take())
+    {
+        if (c.at < 0) c.at = now;
+        pendingCommands.push_back(c);
+        std::push_heap(pendingCommands.begin(), pendingCommands.end(), laterCommand);
+    }
+
+    auto redraw = false;
+    while (!pendingCommands.isEmpty() and pendingCommands.first().at <= now)
+    {
+        std::pop_heap(pendingCommands.begin(), pendingCommands.end(), laterCommand);
+        auto c = pendingCommands.takeLast();
+        c.appliedAt = now;
+        redraw = applyCommand(c) or redraw;
+        commandLog.push_back(c);
+    }
+    return redraw;
+}
+
+
+bool Scene::applyCommand(const command& c)
+{
+    TRACE_SPAN("apply command");
+    switch (c.type) {
+    case command::Reset:
+        resetModel();
+        return true;
+
+    case command::Step:
+        simulate();
+        return false;
+
+    case command::Skip:
+    {
+        for (int i = 0; i < (c.value/interval_ms); ++i)
+        {
+            updateTime();
+        }
+
+        static const auto step = 3;
+        for (int i = 0; i < (c.value/interval_ms/step); ++i)
+        {
+            simulate(double(step));
+        }
+        return false;
+    }
+
+    case command::Rewind:
+        runEvents(std::max(0, getTime() - c.value));
+        return true;
+
+    case command::SetSpeed:
+        if (speed != c.value) {
+            speed = c.value;
+            emit valueChanged(c.value);
+        }
+        return false;
+
+    case command::SetTraffic:
+    {
+        if (!streets.contains(c.street)) return false;
+        auto& s = streets[c.street];
+        if (s.traffic == c.value) return false;
+
+        s.traffic = c.value;
+        applyStreetTraffic(s);
+
+        if (!trafficRouting) return false;
+        replanLines();
+        rerouteBuses();
+        return true;
+    }
+
+    case command::SetTrafficRouting:
+        if (trafficRouting == bool(c.value)) return false;
+
+        // every street changes, new searches are cheaper than repairing the old ones
+        trafficRouting = c.value;
+        replanners.clear();
+        for (const auto& street : streets)
+        {
+            applyStreetTraffic(street);
+        }
+        replanLines();
+        rerouteBuses();
+        return true;
+
+    case command::BlockStreet:
+    case command::UnblockStreet:
+    {
+        if (!streets.contains(c.street)) return false;
+        auto& s = streets[c.street];
+        auto block = c.type == command::BlockStreet;
+
+        if (s.isBlocked == block) return false;
+
+        p.setStreetClosed(s.name, block);
+        ch.setStreetClosed(s.name, block);
+        s.isBlocked = block;
+
+        // a closure breaks only legs going through the street, an opening may shorten any leg
+        if (block) legCache.invalidate(p.getStreetEdges().value(s.name));
+        else legCache.clear();
+
+        // buses on the road avoid the closure right away instead of waiting for a reset
+        updateReplanners(s.name);
+        replanLines();
+        rerouteBuses();
+        return true;
+    }
+
+    case command::EditLine:
+    {
+        if (!lines.contains(c.value) or c.stations.size() < 2) return false;
+        auto& l = lines[c.value];
+        auto start = c.stations.first();
+        auto end = c.stations.last();
+
+        l.start = start;
+        l.end = end;
+        l.stopsAt = c.stations.mid(1, c.stations.size() - 2);
+
+        for (auto &bus : buses)
+        {
+            if (bus.lineno == l.no) {
+                bus.startStation = start;
+                bus.lastStation = start;
+                bus.endStation = end;
+
+                bus.pos_x = std::get<0>(stops[start].coord);
+                bus.pos_y = std::get<1>(stops[start].coord);
+                bus.visited = QVector<std::tuple<int,int>>();
+                bus.slow = 0;
+                bus.wait = bus.initWait;
+                bus.reversed = false;
+                bus.path = getPath(bus);
+            }
+        }
+        return false;
+    }
+
+    case command::ResetLines:
+        for (auto& line : lines)
+        {
+            line.start = line.startOriginal;
+            line.stopsAt = line.stopsAtOriginal;
+            line.end = line.endOriginal;
+            line.pathLines = QVector<std::tuple<int,int,int,int>>();
+        }
+        resetVehicles();
+        routeLines(true);
+        return true;
+    }
+    return false;
+}
+
+
+void Scene::publishFrame()
+{
+    auto& frame = frames.back();
+    frame.number = ++frameNumber;
+    frame.buses.resize(buses.size());
+
+    // every buffer keeps its own grid, the grid is built once and then only buses changing cells are moved
+    auto built = frame.grid.size() != buses.size() or frame.grid.getBounds() != mapBounds;
+    if (built)
+        frame.grid.build(mapBounds, buses.size(), [this](int key) {return QPointF(buses.at(key).pos_x, buses.at(key).pos_y);});
+    for (int i = 0; i < buses.size(); ++i)
+    {
+        const auto& bus = buses.at(i);
+        auto& busFrame = frame.buses[i];
+        busFrame.pos_x = bus.pos_x;
+        busFrame.pos_y = bus.pos_y;
+        busFrame.halt = bus.halt;
+        busFrame.currStreet = bus.currStreet;
+        busFrame.startStation = bus.startStation;
+        busFrame.endStation = bus.endStation;
+        busFrame.lastStation = bus.lastStation;
+        busFrame.headingStation = bus.headingStation;
+        if (!built)
+            frame.grid.move(i, QPointF(bus.pos_x, bus.pos_y));
+    }
+
+    // copies of implicitly shared containers, routes are copied only by the model when it changes them
+    if (frame.lines.size() != lines.size()) frame.lines.clear();
+    for (auto it = lines.cbegin(); it != lines.cend(); ++it)
+    {
+        auto& lineFrame = frame.lines[it.key()];
+        lineFrame.start = it->start;
+        lineFrame.stopsAt = it->stopsAt;
+        lineFrame.end = it->end;
+        lineFrame.pathLines = it->pathLines;
+    }
+
+    if (frame.traffic.size() != streets.size()) frame.traffic.clear();
+    for (auto it = streets.cbegin(); it != streets.cend(); ++it)
+        frame.traffic[it.key()] = it->traffic;
+    frames.publish();
+}
+
+
+void Scene::renderFrame()
+{
+    if (frames.update()) renderBuses();
+}
+
+
+void Scene::redrawLines()
+{
+    // the frame with the new routes was published before this call was queued
+    renderFrame();
     for (auto& line : lines)
     {
         delete line.renderedPath;
         line.renderedPath = new QGraphicsItemGroup;
     }
     renderLines();
+}
 
-    for (auto &bus : buses)
+
+void Scene::setSpeed(int s)
+{
+    command c(command::SetSpeed);
+    c.value = s;
+    post(c);
+}
+
+
+void Scene::setTraffic(int s)
+{
+    if (selectedStreet)
     {
-        bus.reversed = true;
-        getPath(bus);
-        bus.reversed = false;
+        command c(command::SetTraffic);
+        c.street = selectedStreet->name;
+        c.value = s;
+        post(c);
     }
-    renderLines();
 }
 
 
-int Scene::getTime()
+void Scene::setTrafficRouting(bool val)
 {
-    return hours*3600 + minutes*60 + seconds;
+    command c(command::SetTrafficRouting);
+    c.value = val;
+    post(c);
 }
 
 
-void Scene::setSpeed(int s)
+void Scene::applyStreetTraffic(const street &s)
 {
-    if (speed != s) {
-        speed = s;
-        emit valueChanged(s);
+    auto cost = trafficRouting ? float(s.traffic) : 1.0f;
+    const auto changed = p.getStreetEdges().value(s.name);
+    if (!changed.isEmpty())
+    {
+        auto previous = p.getEdges()[changed.first()].cost;
+        if (cost > previous) legCache.invalidate(changed);
+        else if (cost < previous) legCache.clear();
     }
+
+    p.setStreetCost(s.name, cost);
+    ch.setStreetCost(s.name, cost);
+    updateReplanners(s.name);
 }
 
 
-void Scene::setTraffic(int s)
+void Scene::updateTrafficProfiles()
 {
-    if (selectedStreet)
+    auto time = getTime();
+    for (auto& street : streets)
     {
-        selectedStreet->traffic = s;
+        if (!street.profile.isEmpty())
+            street.profileFactor = street.profile.at(time);
+    }
+}
+
+
+void Scene::replanLines()
+{
+    routeLines(false);
+
+    // buses which did not leave the start station yet follow the new route immediately
+    for (auto& bus : buses)
+    {
+        if (inStartStation(bus))
+            bus.path = getPath(bus);
+    }
+}
+
+
+bool Scene::inStartStation(const bus &bus) const
+{
+    if (bus.lastStation != bus.startStation) return false;
+
+    // a waiting or halted bus stands exactly on the station
+    const auto coord = stops.value(bus.startStation).coord;
+    return bus.pos_x == std::get<0>(coord) and bus.pos_y == std::get<1>(coord);
+}
+
+
+void Scene::updateReplanners(const QString &name)
+{
+    const auto changed = p.getStreetEdges().value(name);
+    for (auto& replanner : replanners)
+    {
+        replanner.updateEdges(changed);
+    }
+}
+
+
+QVector<std::tuple<int,int>> Scene::replanFrom(std::tuple<int,int> point, std::tuple<int,int> goal, bool &ok)
+{
+    PROFILE_SCOPE(Profiler::Routing);
+    if (!replanners.contains(goal))
+        replanners.insert(goal, DStarLite(p, goal));
+    auto& replanner = replanners[goal];
+
+    auto solve = [this, &replanner](std::tuple<int,int> start) {
+        PROFILE_COUNT(Profiler::RouteQueries, 1);
+        auto found = replanner.solve(start);
+        PROFILE_COUNT(Profiler::NodesExpanded, replanner.getExpanded());
+        return found;
+    };
+
+    QVector<std::tuple<int,int>> route;
+    if (p.findNode(point) != -1)
+    {
+        ok = solve(point);
+        route = replanner.getSolution();
+        return route;
+    }
+
+    int position = 0;
+    auto e = p.findEdge(point, position);
+    if (e == -1)
+    {
+        ok = false;
+        route.push_back(point);
+        return route;
+    }
+
+    // the bus already drives on the chain, so it may leave it by either end even if the street is closed
+    const auto& edge = p.getEdges()[e];
+    const auto& nodes = p.getGraph();
+    auto distance = [](std::tuple<int,int> a, std::tuple<int,int> b) {
+        return sqrtf(powf(std::get<0>(a) - std::get<0>(b), 2) + powf(std::get<1>(a) - std::get<1>(b), 2));
+    };
+
+    QVector<std::tuple<int,int>> forward, backward;
+    for (int i = position; i < edge.polyline.size(); ++i)
+        forward.push_back(edge.polyline[i]);
+    forward.push_back(std::tuple<int,int>(nodes[edge.to].x, nodes[edge.to].y));
+    for (int i = position; i >= 0; --i)
+        backward.push_back(edge.polyline[i]);
+    backward.push_back(std::tuple<int,int>(nodes[edge.from].x, nodes[edge.from].y));
+
+    auto cost = [&](const QVector<std::tuple<int,int>>& part) {
+        float length = 0.0f;
+        for (int i = 1; i < part.size(); ++i)
+            length += distance(part[i-1], part[i]);
+        if (!solve(part.last())) return float(INFINITY);
+        return length * edge.cost + replanner.getCost();
+    };
+
+    auto forwardCost = cost(forward);
+    auto backwardCost = cost(backward);
+    const auto& part = forwardCost <= backwardCost ? forward : backward;
+    ok = std::min(forwardCost, backwardCost) != INFINITY;
+
+    // the search has to be solved for the chosen end again to return its route
+    solve(part.last());
+    route = part;
+    route.pop_back();
+    for (const auto& step : replanner.getSolution())
+        route.push_back(step);
+    return route;
+}
+
+
+bool Scene::rerouteBus(bus &bus)
+{
+    if (bus.wait > 0 or bus.visited.empty() or bus.path.empty()) return false;
+    if (!lines.contains(bus.lineno)) return false;
+
+    // stations the bus did not reach yet
+    const auto& l = lines[bus.lineno];
+    QVector<QString> stations;
+    stations.push_back(l.start);
+    for (const auto& station : l.stopsAt)
+        stations.push_back(station);
+    stations.push_back(l.end);
+    if (bus.reversed) std::reverse(stations.begin(), stations.end());
+
+    auto remaining = stations.mid(stations.indexOf(bus.lastStation) + 1);
+    if (remaining.empty()) return false;
+
+    // the bus keeps heading to the first point of its path and continues from there
+    const auto& next = bus.path.first();
+    auto from = std::tuple<int,int>(std::get<0>(next), std::get<1>(next));
+
+    bool ok = true;
+    auto route = replanFrom(from, stops.value(remaining.first()).coord, ok);
+
+    double departure = getTime();
+    for (int i = 1; i < remaining.size() and ok; ++i)
+    {
+        auto start = stops.value(remaining[i-1]).coord;
+        auto end = stops.value(remaining[i]).coord;
+        auto solution = findRoute(start, end, departure, routeWorkspace);
+        if (solution.isEmpty() or solution.first() != start or solution.last() != end) ok = false;
+
+        for (int j = 1; j < solution.size(); ++j)
+            route.push_back(solution[j]);
+    }
+
+    bus.halt = !ok;
+    if (!ok) return true;
+
+    QVector<std::tuple<int,int,int,int>> path;
+    path.reserve(route.size());
+    for (int i = 1; i < route.size(); ++i)
+        path.push_back(std::tuple_cat(route[i-1], route[i]));
+    bus.path = path;
+    return true;
+}
+
+
+void Scene::rerouteBuses()
+{
+    TRACE_SPAN("reroute buses");
+    ch.refresh();
+
+    for (auto& bus : buses)
+    {
+        rerouteBus(bus);
     }
 }
 
@@ -175,9 +788,10 @@ void Scene::showLine(int key)
     }
 
     bool show = true;
-    for (const auto& bus : buses)
+    const auto& frame = frames.front();
+    for (int i = 0; i < frame.buses.size() and i < buses.size(); ++i)
     {
-        if (bus.lineno == l.no and bus.halt)
+        if (buses.at(i).lineno == l.no and frame.buses[i].halt)
             show = false;
     }
     if (show)
@@ -218,7 +832,7 @@ line* Scene::getSelectedLine()
 
 bool Scene::selectLineViaBus(int key)
 {
-   if (!buses.contains(key)) return false;
+   if (key < 0 or key >= buses.size()) return false;
 
    if (lines.contains(buses[key].lineno)) {
         selectedLine = &lines[buses[key].lineno];
@@ -271,10 +885,11 @@ bool Scene::getEditMode()
 
 QString Scene::getLineInfo(int key)
 {
-    if (!lines.contains(key)) return "No info";
-    const auto& l = lines[key];
+    const auto& frame = frames.front();
+    if (!frame.lines.contains(key)) return "No info";
 
-    auto result = QString("Line no. %1 -- Goes through: %2").arg(QString::number(l.no), l.start);
+    const auto& l = frame.lines[key];
+    auto result = QString("Line no. %1 -- Goes through: %2").arg(QString::number(key), l.start);
     for (const auto& x: l.stopsAt)
     {
         result += QString(" - %1").arg(x);
@@ -288,10 +903,14 @@ QString Scene::getLineInfo(int key)
 
 QString Scene::getBusInfo(int key)
 {
-    if (!buses.contains(key)) return "No info";
-    const auto& b = buses[key];
-    auto result = QString("Bus no. %1 -- Line no. %2 -- On street: %3 -- Start station: %4 -- ").arg(QString::number(b.no), QString::number(b.lineno), b.currStreet, b.startStation)
-                  + QString("End station: %1 -- Last station: %2 -- Heading to: %3").arg(b.endStation, b.lastStation, b.headingStation);
+    const auto& frame = frames.front();
+    if (key < 0 or key >= buses.size() or key >= frame.buses.size()) return "No info";
+
+    // numbers of the bus and its line do not change after loading
+    const auto& b = buses.at(key);
+    const auto& f = frame.buses[key];
+    auto result = QString("Bus no. %1 -- Line no. %2 -- On street: %3 -- Start station: %4 -- ").arg(QString::number(b.no), QString::number(b.lineno), f.currStreet, f.startStation)
+                  + QString("End station: %1 -- Last station: %2 -- Heading to: %3").arg(f.endStation, f.lastStation, f.headingStation);
     showLine(b.lineno);
 
     if (b.renderedItem)
@@ -351,20 +970,67 @@ QString Scene::getBusHeadingTo(const bus& b)
 
 QString Scene::getStreetInfo(QString key)
 {
-    if (!streets.contains(key)) return "No info";
-    auto& s = streets[key];
+    // streets are not added or removed after loading, their traffic is changed by the simulation
+    const auto& frame = frames.front();
+    auto s = streets.constFind(key);
+    if (s == streets.cend() or !frame.traffic.contains(key)) return "No info";
+
+    emit trafficValueChanged(frame.traffic[key]);
+
+    if (s->renderedPath)
+        s->renderedPath->setSelected(true);
+
+    return s->name;
+}
+
+
+QVector<float> Scene::getStopDistances(QVector<QString>& names)
+{
+    QMutexLocker locker(&modelMutex);
+    names.clear();
+    QVector<std::tuple<int,int>> coords;
+    for (const auto& stop : stops)
+    {
+        names.push_back(stop.name);
+        coords.push_back(stop.coord);
+    }
+
+    return ch.distanceMatrix(coords, coords);
+}
+
+
+bool Scene::exportStopDistances(QString path)
+{
+    QVector<QString> names;
+    auto matrix = getStopDistances(names);
 
-    emit trafficValueChanged(s.traffic);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
 
-    if (s.renderedPath)
-        s.renderedPath->setSelected(true);
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
 
-    return s.name;
+    out.writeRawData("ICPM", 4);
+    out << quint32(names.size());
+    for (const auto& name : names)
+    {
+        auto utf8 = name.toUtf8();
+        out << quint32(utf8.size());
+        out.writeRawData(utf8.constData(), utf8.size());
+    }
+    for (const auto distance : matrix)
+    {
+        out << distance;
+    }
+
+    return out.status() == QDataStream::Ok;
 }
 
 
 bool Scene::blockStreet(QString key)
 {
+    TRACE_SPAN("block street");
     QColor gray90 = Qt::black;
     gray90.setAlphaF(0.9);
     pen.setBrush(gray90);
@@ -374,20 +1040,15 @@ bool Scene::blockStreet(QString key)
     {
         if(street.name == key)
         {
-            if(street.isBlocked)
-                return true;
-
             for (const auto& line : street.pathLines)
             {
                 this->addLine(std::get<0>(line), std::get<1>(line),std::get<2>(line), std::get<3>(line), pen);
             }
 
-            for (const auto& point : street.mid)
-            {
-                p.setNodeObstacle(point, true);
-            }
-
-            street.isBlocked = true;
+            // routing graphs are changed by the simulation
+            command c(command::BlockStreet);
+            c.street = key;
+            post(c);
             return true;
         }
     }
@@ -397,6 +1058,7 @@ bool Scene::blockStreet(QString key)
 
 bool Scene::unblockStreet(QString key)
 {
+    TRACE_SPAN("unblock street");
     pen.setColor(Qt::darkGray);
     pen.setWidth(3);
 
@@ -404,20 +1066,15 @@ bool Scene::unblockStreet(QString key)
     {
         if(street.name == key)
         {
-            if(!street.isBlocked)
-                return true;
-
             for (const auto& line : street.pathLines)
             {
                 this->addLine(std::get<0>(line), std::get<1>(line),std::get<2>(line), std::get<3>(line), pen);
             }
 
-            for (const auto& point : street.mid)
-            {
-                p.setNodeObstacle(point, false);
-            }
-
-            street.isBlocked = false;
+            // routing graphs are changed by the simulation
+            command c(command::UnblockStreet);
+            c.street = key;
+            post(c);
             return true;
         }
     }
@@ -433,22 +1090,23 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event)
     }
     else
     {
-        QGraphicsScene::mousePressEvent(event);
+        // only items near the cursor are tested, the generic hit-testing of the scene is skipped
+        PROFILE_SCOPE(Profiler::Pick);
+        auto key = pickIndex.pick(event->scenePos(), 4 / viewScale, itemGrid);
+        clearSelection();
 
-        if (!this->selectedItems().empty())
+        if (key >= 0)
         {
+            const auto& cont = renderedItems[key];
+            cont.item->setSelected(true);
             lastSelectedItem = selectedItem;
-            selectedItem = this->selectedItems().first();
-
-            auto key = selectedItem->data(0);
-            auto cont = renderedItems[key.toInt()];
+            selectedItem = cont.item;
 
-            if (cont.type != "")
-            {
-                QString data;
-                trafficEnabledChanged(false);
+            QString data;
+            trafficEnabledChanged(false);
 
-                if (cont.type == "street") {
+            switch (cont.type) {
+                case container::Street:
                     data = getStreetInfo(cont.stringKey);
 
                     if (editMode == 0) {
@@ -459,8 +1117,9 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event)
                         hideLines();
                         emit infoLabelChanged(data);
                     }
+                    break;
 
-                } else if (cont.type == "stop") {
+                case container::Stop:
                     data = cont.stringKey;
                     deselectStreet();
 
@@ -474,8 +1133,9 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event)
                     }
 
                     emit infoLabelChanged(data);
+                    break;
 
-                } else if (cont.type == "line") {
+                case container::Line:
                     data = getLineInfo(cont.intKey);
                     deselectStreet();
                     if (editMode == 0) {
@@ -485,8 +1145,9 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event)
                         emit lineEditEnabledChanged(true);
                         emit infoLabelChanged(data);
                     }
+                    break;
 
-                } else if (cont.type == "bus") {
+                case container::Bus:
                     data = getBusInfo(cont.intKey);
                     deselectStreet();
                     if (editMode == 0) {
@@ -496,8 +1157,10 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event)
                         emit lineEditEnabledChanged(true);
                         emit infoLabelChanged(data);
                     }
-                }
+                    break;
 
+                case container::None:
+                    break;
             }
         } else {
             if (editMode == 0) {
@@ -521,35 +1184,13 @@ bool Scene::saveEdit()
         return false;
     }
 
-    auto start = routeEditTemp.first();
-    auto end = routeEditTemp.last();
-
-    routeEditTemp.pop_front();
-    routeEditTemp.pop_back();
-
-    selectedLine->start = start;
-    selectedLine->end = end;
-    selectedLine->stopsAt = routeEditTemp;
+    command c(command::EditLine);
+    c.value = selectedLine->no;
+    c.stations = routeEditTemp;
+    post(c);
 
     routeEditTemp = QVector<QString>();
 
-    for (auto &bus : buses)
-    {
-        if (bus.lineno == selectedLine->no) {
-            bus.startStation = start;
-            bus.lastStation = start;
-            bus.endStation = end;
-
-            bus.pos_x = std::get<0>(stops[start].coord);
-            bus.pos_y = std::get<1>(stops[start].coord);
-            bus.visited = QVector<std::tuple<int,int>>();
-            bus.slow = 0;
-            bus.wait = bus.initWait;
-            bus.reversed = false;
-            bus.path = getPath(bus);
-        }
-    }
-
     delete selectedLine->renderedPath;
     selectedLine->renderedPath = new QGraphicsItemGroup;
 
@@ -558,30 +1199,68 @@ bool Scene::saveEdit()
 }
 
 
-void Scene::loadAll()
+bool Scene::loadAll(const std::function<bool(int)>& stage, const std::atomic<bool> *cancelled)
 {
     loadBackground();
     loadLines();
     loadVehicles();
 
-    p.loadPoints(points);
-    p.loadPaths(streets, points);
+    if (!stage(BuildingGraph)) return false;
 
-    // render lines from both sides (may have different route)
-    for (auto &bus : buses)
+    // stations stay nodes of the graph, other points of streets only if they are crossings or ends of streets
+    QVector<std::tuple<int,int>> stations;
+    for (const auto& stop : stops)
+        stations.push_back(stop.coord);
+
+    p.loadPoints(stations);
+    p.loadPaths(streets);
+    ch.build(p);
+
+    // routes computed by a previous run of the same map skip the pathfinding (ICP_ROUTE_CACHE names the directory)
+    RouteCacheFile cacheFile(qEnvironmentVariable("ICP_ROUTE_CACHE"));
+    QStringList closed;
+    for (const auto& street : streets)
     {
-        bus.reversed = true;
-        getPath(bus);
+        if (street.isBlocked) closed.push_back(street.name);
     }
-    renderLines();
+    auto cacheKey = RouteCacheFile::key(mapDigest, closed, trafficRouting);
+    auto warm = cacheFile.load(cacheKey, p, alternatives, legCache);
 
-    for (auto &bus : buses)
+    if (!stage(Routing)) return false;
+
+    // legs of lines in both directions get alternative routes, closures are then resolved without a search
+    if (!warm)
     {
-        bus.reversed = false;
-        bus.path = getPath(bus);
+        QVector<std::pair<std::tuple<int,int>, std::tuple<int,int>>> legs;
+        for (const auto& line : lines)
+        {
+            QVector<std::tuple<int,int>> coords;
+            coords.push_back(stops.value(line.start).coord);
+            for (const auto& station : line.stopsAt)
+                coords.push_back(stops.value(station).coord);
+            coords.push_back(stops.value(line.end).coord);
+
+            for (int i = 1; i < coords.size(); ++i)
+            {
+                legs.push_back(std::make_pair(coords[i-1], coords[i]));
+                legs.push_back(std::make_pair(coords[i], coords[i-1]));
+            }
+        }
+        if (!alternatives.build(p, legs, 3, cancelled)) return false;
     }
-    renderLines();
-    //
+
+    for (const auto& street : streets)
+    {
+        if (street.profile.isEmpty()) continue;
+
+        p.setStreetProfile(street.name, p.addProfile(street.profile));
+    }
+    updateTrafficProfiles();
+
+    // render lines from both sides (may have different route)
+    if (!routeLines(true, cancelled)) return false;
+    if (cacheFile.isEnabled() and !warm) cacheFile.save(cacheKey, p, alternatives, legCache);
+    return true;
 }
 
 
@@ -627,10 +1306,24 @@ void Scene::loadBackground()
 
         pathLines.push_back(std::tuple_cat(start, end));
 
+        // "profile": [{"at": "07:30", "traffic": 3}, ...]
+        for (auto element : streetObj["profile"].toArray())
+        {
+            auto pointObj = element.toObject();
+            auto at = pointObj["at"].toString().split(":");
+            if (at.size() != 2) continue;
+
+            auto second = at[0].toInt()*3600 + at[1].toInt()*60;
+            streetStruct.profile.add(second, std::max(1.0, pointObj["traffic"].toDouble()));
+        }
+
         streetStruct.name = streetObj["name"].toString();
         streetStruct.pathLines = pathLines;
         streets.insert(streetObj["name"].toString(), streetStruct);
     }
+
+    for (const auto& point : points)
+        mapBounds |= QRectF(std::get<0>(point), std::get<1>(point), 1, 1);
 }
 
 
@@ -650,7 +1343,25 @@ void Scene::loadLines()
             stopsAt.push_back(goesThrough.toString());
         }
 
-        line l {lineObj["no"].toInt(), lineObj["color"].toString(), start, start, stopsAt, stopsAt, end, end, pathLines, nullptr};
+        // timetable of departures from the start station ("HH:MM" or "HH:MM:SS")
+        QVector<int> timetable;
+        for (auto departure : lineObj["timetable"].toArray())
+        {
+            auto at = departure.toString().split(":");
+            if (at.size() < 2) continue;
+
+            auto second = at[0].toInt()*3600 + at[1].toInt()*60 + (at.size() > 2 ? at[2].toInt() : 0);
+            timetable.push_back(second * 1000);
+        }
+        std::sort(timetable.begin(), timetable.end());
+
+        // optional frequency plan of the line (times in seconds)
+        auto fleet = std::max(0, lineObj["fleet"].toInt(fleetSize));
+        auto headway = int(lineObj["headway"].toDouble(waitBeforeStart / 1000.0) * 1000);
+        auto layover = int(lineObj["layover"].toDouble(waitStop / 1000.0) * 1000);
+
+        line l {lineObj["no"].toInt(), lineObj["color"].toString(), start, start, stopsAt, stopsAt, end, end, pathLines, nullptr,
+                    fleet, headway, layover, timetable};
         lines.insert(lineObj["no"].toInt(), l);
     }
 }
@@ -664,8 +1375,6 @@ void Scene::renderStreets()
     for (auto& street : streets)
     {
         renderedStreets = new QGraphicsItemGroup;
-        container c;
-        c.type = "street";
         for (const auto& line : street.pathLines)
         {
             auto streetLine = this->addLine(std::get<0>(line), std::get<1>(line),std::get<2>(line), std::get<3>(line), pen);
@@ -674,7 +1383,7 @@ void Scene::renderStreets()
         }
         renderedStreets->setFlag(QGraphicsItem::ItemIsSelectable);
 
-        auto itemKey = renderedItemsKeyGen.gen();
+        auto itemKey = renderedItems.size();
         renderedStreets->setData(0, itemKey);
         this->addItem(renderedStreets);
 
@@ -682,8 +1391,8 @@ void Scene::renderStreets()
 
         street.renderedPath = renderedStreets;
 
-        c.stringKey = street.name;
-        renderedItems.insert(itemKey, c);
+        renderedItems.push_back(container {container::Street, street.name, 0, renderedStreets});
+        pickIndex.addStreet(itemKey, street.pathLines);
     }
 }
 
@@ -696,8 +1405,6 @@ void Scene::renderStops()
     for (auto& stop : stops)
     {
         renderedStop = new QGraphicsItemGroup;
-        container c;
-        c.type = "stop";
 
         auto dot = this->addEllipse(std::get<0>(stop.coord)-9, std::get<1>(stop.coord)-9, 18, 18, pen, QBrush(Qt::white));
         auto label = this->addText(stop.name);
@@ -708,15 +1415,15 @@ void Scene::renderStops()
         renderedStop->addToGroup(label);
         renderedStop->setFlag(QGraphicsItem::ItemIsSelectable);
 
-        auto itemKey = renderedItemsKeyGen.gen();
+        auto itemKey = renderedItems.size();
         renderedStop->setData(0, itemKey);
         renderedStop->setZValue(2);
 
         stop.rendered = renderedStop;
         this->addItem(renderedStop);
 
-        c.stringKey = stop.name;
-        renderedItems.insert(itemKey, c);
+        renderedItems.push_back(container {container::Stop, stop.name, 0, renderedStop});
+        pickIndex.addStop(itemKey, renderedStop);
     }
 }
 
@@ -733,7 +1440,7 @@ void Scene::renderLines()
             renderedLines = line.renderedPath;
         pen.setColor(line.color);
 
-        for (const auto& path : line.pathLines)
+        for (const auto& path : frames.front().lines.value(line.no).pathLines)
         {
             auto lineDrawn = this->addLine(std::get<0>(path), std::get<1>(path),std::get<2>(path), std::get<3>(path), pen);
             renderedLines->addToGroup(lineDrawn);
@@ -749,43 +1456,57 @@ void Scene::renderLines()
 
 void Scene::resetLines()
 {
-    for (auto& line : lines)
-    {
-        line.start = line.startOriginal;
-        line.stopsAt = line.stopsAtOriginal;
-        line.end = line.endOriginal;
-        line.pathLines = QVector<std::tuple<int,int,int,int>>();
-        delete line.renderedPath;
-        line.renderedPath = new QGraphicsItemGroup;
-    }
-    resetVehicles();
-    renderLines();
+    post(command(command::ResetLines));
 }
 
 
 void Scene::loadVehicles()
 {
-    auto nextBus = waitBeforeStart;
-    for (const auto element : json["buses"].toArray())
+    const auto entries = json["buses"].toArray();
+
+    // every entry dispatches the fleet of its line, the timetable of a line is dispatched once by its first entry
+    QVector<int> fleet;
+    QSet<int> timetabled;
+    auto total = 0;
+    for (const auto element : entries)
     {
-        auto busObj = element.toObject();
+        auto lineno = element.toObject()["lineno"].toInt();
+        const auto& l = lines[lineno];
+        if (l.timetable.empty()) {
+            fleet.push_back(l.fleet);
+        } else {
+            fleet.push_back(timetabled.contains(lineno) ? 0 : l.timetable.size());
+            timetabled.insert(lineno);
+        }
+        total += fleet.last();
+    }
+
+    buses.clear();
+    buses.reserve(total);
+
+    for (int entry = 0; entry < entries.size(); ++entry)
+    {
+        if (fleet[entry] == 0) continue;
+
+        auto busObj = entries[entry].toObject();
         QVector<std::tuple<int,int>> visited;
         QVector<std::tuple<int,int,int,int>> path;
 
-        auto pos = stops[lines[busObj["lineno"].toInt()].start];
+        const auto& l = lines[busObj["lineno"].toInt()];
+        auto pos = stops[l.start];
         auto startX = double(std::get<0>(pos.coord));
         auto startY = double(std::get<1>(pos.coord));
-        auto startStation = lines[busObj["lineno"].toInt()].start;
-        auto endStation = lines[busObj["lineno"].toInt()].end;
+        auto startStation = l.start;
+        auto endStation = l.end;
         auto startAt = busObj["startat"].toInt()*1000;
 
-        for (int i = 0; i < 10; ++i)
+        for (int i = 0; i < fleet[entry]; ++i)
         {
-            auto key = busKeyGen.gen();
+            auto departure = l.timetable.empty() ? startAt + l.headway*i : l.timetable[i];
             bus b {busObj["no"].toInt(), busObj["lineno"].toInt(), startX, startY, 0.0, false, false, 1,
-                        startAt + nextBus*i, startAt + nextBus*i, startStation, startStation, "", endStation, "", visited, path, nullptr};
+                        departure, departure, startStation, startStation, "", endStation, "", visited, path, nullptr};
             b.headingStation = getBusHeadingTo(b);
-            buses.insert(key, b);
+            buses.push_back(b);
         }
     }
 }
@@ -808,10 +1529,7 @@ void Scene::resetVehicles()
         bus.visited = QVector<std::tuple<int,int>>();
         bus.halt = false;
         bus.slow = 1;
-        bus.path = getPath(bus);
         bus.wait = bus.initWait;
-        bus.renderedItem->setX(bus.pos_x);
-        bus.renderedItem->setY(bus.pos_y);
     }
 }
 
@@ -821,11 +1539,9 @@ void Scene::renderVehicles()
     pen.setWidth(3);
     pen.setColor(Qt::black);
 
-    for (auto& key : buses.keys())
+    for (int key = 0; key < buses.size(); ++key)
     {
         QGraphicsItemGroup * renderedItem = new QGraphicsItemGroup;
-        container c;
-        c.type = "bus";
 
         pen.setColor(lines[buses[key].lineno].color);
         auto busDot = this->addEllipse(buses[key].pos_x-6, buses[key].pos_y-6, 12, 12, pen, QBrush(Qt::white));
@@ -838,58 +1554,81 @@ void Scene::renderVehicles()
         renderedItem->setFlag(QGraphicsItem::ItemIsSelectable);
         renderedItem->setZValue(3);
 
-        auto itemKey = renderedItemsKeyGen.gen();
+        auto itemKey = renderedItems.size();
         renderedItem->setData(0, itemKey);
         buses[key].renderedItem = renderedItem;
         this->addItem(renderedItem);
 
-        c.intKey = key;
-        renderedItems.insert(itemKey, c);
+        renderedItems.push_back(container {container::Bus, "", key, renderedItem});
+        pickIndex.addBus(itemKey, renderedItem);
     }
 }
 
 
 QVector<std::tuple<int,int,int,int>> Scene::getPath(bus &bus)
 {
-    QVector<std::tuple<int,int>> path;
-    auto start = stops[lines[bus.lineno].start].coord;
-    auto end = stops[lines[bus.lineno].end].coord;
-    auto mid = lines[bus.lineno].stopsAt;
+    TRACE_SPAN("getPath");
+    ch.refresh();
 
-    if (bus.reversed) swap(start, end);
+    bool halt = false;
+    auto result = computePath(bus.lineno, bus.reversed, getTime() + bus.wait / 1000.0, halt, routeWorkspace);
+    if (halt) bus.halt = true;
 
-    auto startSaved = start;
+    lines[bus.lineno].pathLines = result;
 
-    if (!mid.empty())
-    {
-        if (bus.reversed) std::reverse(mid.begin(), mid.end());
+    return result;
+}
 
-        path.push_back(std::tuple<int,int>(0,0));
-        for (const auto& key : mid)
-        {
-            path.pop_back();
-            auto mid_point = stops[key].coord;
-            p.loadGoal(start, mid_point);
-            p.solveAStar();
-            auto solution = p.getSolution();
 
-            if (solution.first() != start) bus.halt = true;
-            if (solution.last() != mid_point) bus.halt = true;
+QVector<std::tuple<int,int,int,int>> Scene::computePath(int lineno, bool reversed, double departure, bool &halt, RouteWorkspace &workspace) const
+{
+    auto& path = workspace.path;
+    path.clear();
+
+    // appends element by element, assigning into the empty buffer would share the solution instead of reusing the buffer
+    auto append = [&path](const QVector<std::tuple<int,int>>& solution) {
+        for (const auto& point : solution)
+            path.push_back(point);
+    };
+
+    const auto line = lines.value(lineno);
+    auto start = stops.value(line.start).coord;
+    auto end = stops.value(line.end).coord;
+    const auto& mid = line.stopsAt;
 
-            path += solution;
-            start = mid_point;
+    if (reversed) swap(start, end);
+
+    auto startSaved = start;
+
+    // no route is found if a station is not a node of the graph (e.g. it is missing in the map)
+    auto appendLeg = [&path, &halt, &append](const QVector<std::tuple<int,int>>& solution, std::tuple<int,int> from, std::tuple<int,int> to) {
+        if (solution.isEmpty()) {
+            halt = true;
+            return;
         }
-        path.pop_back();
+        if (solution.first() != from) halt = true;
+        if (solution.last() != to) halt = true;
+
+        // the station shared by two following legs is stored once
+        if (!path.isEmpty() and path.last() == solution.first()) path.pop_back();
+        append(solution);
+    };
+
+    for (int i = 0; i < mid.size(); ++i)
+    {
+        const auto& key = reversed ? mid[mid.size() - 1 - i] : mid[i];
+        auto mid_point = stops.value(key).coord;
+        appendLeg(findRoute(start, mid_point, departure, workspace), start, mid_point);
+        start = mid_point;
     }
 
-    p.loadGoal(start, end);
-    p.solveAStar();
-    path += p.getSolution();
+    appendLeg(findRoute(start, end, departure, workspace), start, end);
 
-    if (path.first() != startSaved) bus.halt = true;
-    if (path.last() != end) bus.halt = true;
+    if (path.isEmpty() or path.first() != startSaved) halt = true;
+    if (path.isEmpty() or path.last() != end) halt = true;
 
     QVector<std::tuple<int,int,int,int>> result;
+    result.reserve(path.size());
 
     if (path.size() > 1) {
         std::tuple<int,int> temp = path.first();
@@ -902,12 +1641,119 @@ QVector<std::tuple<int,int,int,int>> Scene::getPath(bus &bus)
         result.push_back(std::tuple_cat(temp, path.last()));
     }
 
-    lines[bus.lineno].pathLines = result;
-
     return result;
 }
 
 
+bool Scene::routeBuses(bool reversed, bool assignPath, const std::atomic<bool> *cancelled)
+{
+    TRACE_SPAN("route buses");
+    ch.refresh();
+
+    // buses of the same line share a route unless it depends on the departure time
+    struct Job {
+        int lineno;
+        double departure;
+        bool halt;
+        QVector<std::tuple<int,int,int,int>> path;
+    };
+    QVector<Job> jobs;
+    QMap<std::tuple<int,double>, int> jobIndex;
+    QVector<int> busJob(buses.size());
+
+    const bool timeDependent = trafficRouting and p.hasProfiles();
+    for (int i = 0; i < buses.size(); ++i)
+    {
+        auto departure = timeDependent ? getTime() + buses[i].wait / 1000.0 : 0.0;
+        auto key = std::tuple<int,double>(buses[i].lineno, departure);
+        if (!jobIndex.contains(key)) {
+            jobIndex.insert(key, jobs.size());
+            jobs.push_back(Job {buses[i].lineno, departure, false, QVector<std::tuple<int,int,int,int>>()});
+        }
+        busJob[i] = jobIndex[key];
+    }
+
+    QtConcurrent::blockingMap(jobs, [this, reversed, cancelled](Job& job) {
+        if (cancelled and cancelled->load()) return;
+
+        thread_local RouteWorkspace workspace;
+        TRACE_SPAN("route line");
+        job.path = computePath(job.lineno, reversed, job.departure, job.halt, workspace);
+    });
+    if (cancelled and cancelled->load()) return false;
+
+    for (int i = 0; i < buses.size(); ++i)
+    {
+        const auto& job = jobs[busJob[i]];
+        // buses in the start station start again once both directions of their line are routed,
+        // buses on the road are released by rerouteBus()
+        if (inStartStation(buses[i]))
+            buses[i].halt = reversed ? buses[i].halt or job.halt : job.halt;
+        else if (job.halt)
+            buses[i].halt = true;
+        if (assignPath) buses[i].path = job.path;
+        lines[buses[i].lineno].pathLines = job.path;
+    }
+    return true;
+}
+
+
+QVector<std::tuple<int,int>> Scene::findRoute(std::tuple<int,int> start, std::tuple<int,int> end, double &departure, RouteWorkspace &workspace) const
+{
+    PROFILE_SCOPE(Profiler::Routing);
+    PROFILE_COUNT(Profiler::RouteQueries, 1);
+    if (trafficRouting and p.hasProfiles())
+    {
+        // a bus moves by one unit every tick on a street with the traffic factor 1
+        auto speed = 1000.0 / interval_ms;
+
+        p.loadGoal(start, end, workspace.astar);
+        p.solveAStar(departure, speed, workspace.astar);
+
+        auto cost = p.getSolutionCost(workspace.astar);
+        if (cost != INFINITY) departure += cost / speed;
+        PROFILE_COUNT(Profiler::NodesExpanded, workspace.astar.expanded);
+        TRACE_COUNTER("open set", workspace.astar.maxOpen);
+        return p.getSolution(workspace.astar);
+    }
+
+    QVector<std::tuple<int,int>> route;
+    if (legCache.find(start, end, route))
+    {
+        PROFILE_COUNT(Profiler::LegCacheHits, 1);
+        return route;
+    }
+    auto epoch = legCache.getEpoch();
+
+    if (!trafficRouting)
+    {
+        auto alternative = alternatives.find(p, start, end);
+        if (alternative) {
+            legCache.insert(start, end, alternative->points, alternative->edges, epoch);
+            return alternative->points;
+        }
+    }
+
+    if (ch.isBuilt())
+    {
+        ch.loadGoal(start, end, workspace.hierarchy);
+        ch.solve(workspace.hierarchy);
+        PROFILE_COUNT(Profiler::NodesExpanded, workspace.hierarchy.touched.size());
+        route = ch.getSolution(workspace.hierarchy);
+        legCache.insert(start, end, route, ch.getSolutionEdges(workspace.hierarchy), epoch);
+        return route;
+    }
+
+    p.loadGoal(start, end, workspace.astar);
+    p.solveAStar(workspace.astar);
+    PROFILE_COUNT(Profiler::NodesExpanded, workspace.astar.expanded);
+    TRACE_COUNTER("open set", workspace.astar.maxOpen);
+    route = p.getSolution(workspace.astar);
+    legCache.insert(start, end, route, p.getSolutionEdges(workspace.astar), epoch);
+    return route;
+}
+
+
 void Scene::setNewPosition(bus &bus, double step)
 {
     // if bus has to wait
@@ -931,9 +1777,9 @@ void Scene::setNewPosition(bus &bus, double step)
 
         bus.startStation = start;
         bus.endStation = end;
+        bus.wait = lines[bus.lineno].layover;
         bus.path = getPath(bus);
         bus.visited = QVector<std::tuple<int,int>>();
-        bus.wait = waitStop;
     }
 
     std::tuple<int,int,int,int> new_pos;
@@ -992,11 +1838,9 @@ void Scene::setNewPosition(bus &bus, double step)
     if (bus.halt == false)
     {
         // move the bus
-        bus.renderedItem->setX(bus.pos_x + (step/bus.slow * cos(bus.d)));
-        bus.renderedItem->setY(bus.pos_y + (step/bus.slow * sin(bus.d)));
+        bus.pos_x += step/bus.slow * cos(bus.d);
+        bus.pos_y += step/bus.slow * sin(bus.d);
 
-        bus.pos_x = bus.renderedItem->pos().x();
-        bus.pos_y = bus.renderedItem->pos().y();
 
         // get current street name
         int lastPoint_x, lastPoint_y, nextPoint_x, nextPoint_y;
@@ -1021,19 +1865,217 @@ void Scene::setNewPosition(bus &bus, double step)
             }
 
             // sets how fast the bus in on the current street
-            if (bus.currStreet == street.name) bus.slow = street.traffic;
+            if (bus.currStreet == street.name) bus.slow = street.traffic * street.profileFactor;
         }
 
     }
 }
 
 
+void Scene::updateBusItem(int key)
+{
+    const auto& frame = frames.front();
+    if (key >= frame.buses.size()) return;
+    const auto& busFrame = frame.buses[key];
+    auto item = buses.at(key).renderedItem;
+
+    // the item (and the region repainted by the view) changes only after the bus moved by a whole pixel
+    auto moved = item->pos() - QPointF(busFrame.pos_x, busFrame.pos_y);
+    if (fabs(moved.x()) * viewScale >= 1 or fabs(moved.y()) * viewScale >= 1) {
+        item->setPos(busFrame.pos_x, busFrame.pos_y);
+        itemGrid.move(key, item->pos());
+        PROFILE_COUNT(Profiler::ItemsMoved, 1);
+    }
+}
+
+
+void Scene::renderBuses()
+{
+    TRACE_SPAN("render buses");
+    static const auto margin = 64.0;    ///< Pixels around the view, covers the dot and the label of a bus
+
+    if (views().isEmpty()) {
+        viewScale = 1.0;
+        renderRect = sceneRect();
+    } else {
+        auto view = views().first();
+        viewScale = view->transform().m11();
+        renderRect = view->mapToScene(view->viewport()->rect()).boundingRect();
+        renderRect.adjust(-margin / viewScale, -margin / viewScale, margin / viewScale, margin / viewScale);
+    }
+
+    // grids are kept up to date by moving buses and items, only buses near the view are visited
+    ++renderPass;
+    renderedAt.resize(buses.size());
+    visible.resize(0);
+    auto collect = [this](int key) {
+        if (key >= renderedAt.size() or renderedAt[key] == renderPass) return;
+        renderedAt[key] = renderPass;
+        visible.push_back(key);
+    };
+
+    // buses which got into the view and items of buses which left it, items are moved after the queries
+    frames.front().grid.query(renderRect, collect);
+    itemGrid.query(renderRect, collect);
+    for (const auto key : visible)
+        updateBusItem(key);
+}
+
+
 void Scene::simulate(double step)
 {
+    PROFILE_SCOPE(Profiler::Simulate);
+    TRACE_SPAN("simulate");
     if (speed != 0) {
         for (auto &bus : buses)
         {
             setNewPosition(bus, step);
         }
     }
+
+    if (Tracer::instance().isActive()) {
+        auto halted = 0;
+        for (const auto &bus : buses)
+        {
+            if (bus.halt) ++halted;
+        }
+        Tracer::instance().counter("fleet size", buses.size());
+        Tracer::instance().counter("halted buses", halted);
+    }
+}
+
+
+qint64 Scene::jumpTo(int second)
+{
+    qint64 processed;
+    {
+        QMutexLocker locker(&modelMutex);
+        processed = runEvents(second);
+        publishFrame();
+    }
+    redrawLines();
+    return processed;
+}
+
+
+qint64 Scene::runEvents(int second)
+{
+    TRACE_SPAN("jump to");
+    resetModel();
+    ch.refresh();
+
+    // every segment of a route is a segment of a street in one of its directions
+    QMap<std::tuple<int,int,int,int>, const street*> segmentStreets;
+    for (const auto& s : streets)
+    {
+        for (const auto& path : s.pathLines)
+        {
+            segmentStreets.insert(path, &s);
+            segmentStreets.insert(std::tuple<int,int,int,int>(std::get<2>(path), std::get<3>(path), std::get<0>(path), std::get<1>(path)), &s);
+        }
+    }
+
+    auto provider = [this, &segmentStreets](int lineno, bool reversed, double departure) {
+        EventSimulation::Route route;
+        route.segments = computePath(lineno, reversed, departure, route.halt, routeWorkspace);
+
+        const auto& l = lines[lineno];
+        for (const auto& segment : route.segments)
+        {
+            auto end = std::tuple<int,int>(std::get<2>(segment), std::get<3>(segment));
+            auto name = stopsReversed.contains(end) ? stopsReversed[end].name : QString();
+
+            if (name.isEmpty() or (l.start != name and l.end != name and !l.stopsAt.contains(name)))
+                name = QString();
+            route.stations.push_back(name);
+            route.streets.push_back(segmentStreets.value(segment, nullptr));
+        }
+        return route;
+    };
+
+    EventSimulation events(provider, interval_ms, !(trafficRouting and p.hasProfiles()));
+    for (const auto& bus : buses)
+    {
+        events.addVehicle(bus.lineno, bus.startStation, bus.endStation, QPointF(bus.pos_x, bus.pos_y),
+                          bus.halt ? std::numeric_limits<qint64>::max() : bus.initWait, lines[bus.lineno].layover);
+    }
+    events.run(qint64(second) * 1000);
+
+    countTime = 0;
+    hours = (second / 3600) % 24;
+    minutes = (second / 60) % 60;
+    seconds = second % 60;
+    updateTrafficProfiles();
+
+    // buses continue from the state reached by the engine
+    for (int i = 0; i < buses.size(); ++i)
+    {
+        const auto& vehicle = events.vehicle(i);
+        auto& bus = buses[i];
+        auto position = events.position(i);
+
+        bus.pos_x = position.x();
+        bus.pos_y = position.y();
+        bus.reversed = vehicle.reversed;
+        bus.startStation = vehicle.startStation;
+        bus.lastStation = vehicle.lastStation;
+        bus.endStation = vehicle.endStation;
+        bus.halt = bus.halt or vehicle.state == EventSimulation::Halted;
+        bus.visited = QVector<std::tuple<int,int>>();
+
+        if (vehicle.state == EventSimulation::Driving) {
+            const auto& segment = vehicle.route->segments[vehicle.segment];
+            const auto road = vehicle.route->streets[vehicle.segment];
+
+            bus.wait = 0;
+            bus.visited.push_back(std::tuple<int,int>(std::get<0>(segment), std::get<1>(segment)));
+            bus.path = vehicle.route->segments.mid(vehicle.segment + 1);
+            bus.d = atan2(std::get<3>(segment) - std::get<1>(segment), std::get<2>(segment) - std::get<0>(segment));
+            bus.currStreet = road ? road->name : QString();
+            bus.slow = road ? road->traffic * road->profileFactor : 1;
+        } else if (vehicle.state == EventSimulation::Waiting) {
+            bus.wait = int(std::min<qint64>(vehicle.until - events.time(), std::numeric_limits<int>::max()));
+            // buses waiting in the end station already turned around
+            if (vehicle.route) bus.path = getPath(bus);
+        }
+        bus.headingStation = getBusHeadingTo(bus);
+    }
+
+    emit timeValueChanged(QString::number(hours).rightJustified(2, '0') + QString(":") +
+                          QString::number(minutes).rightJustified(2, '0') + QString(":") +
+                          QString::number(seconds).rightJustified(2, '0'));
+    TRACE_COUNTER("events", events.processed());
+    return events.processed();
+}
+
+
+void Scene::profileTick()
+{
+    PROFILE_TICK();
+}
+
+
+void Scene::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawBackground(painter, rect);
+    Tracer::instance().begin("paint");
+#ifdef ICP_PROFILING
+    paintTimer.start();
+#endif
+}
+
+
+void Scene::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawForeground(painter, rect);
+    Tracer::instance().end("paint");
+#ifdef ICP_PROFILING
+    // items are painted between the background and the foreground
+    if (paintTimer.isValid()) {
+        Profiler::instance().addTime(Profiler::Paint, paintTimer.nsecsElapsed());
+        paintTimer.invalidate();
+    }
+    PROFILE_COUNT(Profiler::ItemsRepainted, items(rect).size());
+    PROFILE_COUNT(Profiler::AreaRepainted, qint64(rect.width() * rect.height() * pow(painter->worldTransform().m11(), 2)));
+#endif
 }
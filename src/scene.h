@@ -9,11 +9,13 @@
 #define SCENE_H
 
 #include <QGraphicsScene>
+#include <QGraphicsView>
 #include <QGraphicsItemGroup>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsSceneHoverEvent>
 #include <QByteArray>
 #include <QFile>
+#include <QDataStream>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonArray>
@@ -24,16 +26,40 @@
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
 #include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <QtConcurrent>
 #include <cmath>
 #include <algorithm>
 #include <tuple>
 
 #include "pathfinding.h"
+#include "contractionhierarchy.h"
+#include "dstarlite.h"
+#include "alternativeroutes.h"
+#include "legcache.h"
+#include "routecachefile.h"
+#include "eventsimulation.h"
+#include "spatialgrid.h"
+#include "pickindex.h"
+#include "commandqueue.h"
+#include "simulationworker.h"
+#include "triplebuffer.h"
+#include "profiler.h"
+#include "tracer.h"
 
 /*!
  * \brief Implements the logic behing rendering and animating items on QGraphicsScene.
  * \details Loads data from JSON file into the program's datastructures, renders and moves them accordingly.
  * Manages mouse click events on the scene.
+ * After play() the simulation runs on its own thread. The model (buses, lines, streets, routing graphs and time) is changed
+ * only under "modelMutex" and by the simulation thread. Operator actions are posted as commands through a lock-free queue
+ * and applied between two ticks. Items are changed only on the GUI thread, positions and stations of buses and routes
+ * of lines are handed over by frames published through a lock-free triple buffer, so the GUI thread does not wait
+ * for rerouting done under the lock.
  */
 class Scene : public QGraphicsScene
 {
@@ -44,35 +70,116 @@ private:
     int hours = 0;
     int minutes = 0;
     int seconds = 0;
-    int waitStop = 3000;            ///< How much milliseconds a bus waits after arriving into the end station
-    int waitBeforeStart = 10000;    ///< How much milliseconds a bus waits when leaving the start station after another bus leaves
+    int waitStop = 3000;            ///< Default layover, how much milliseconds a bus waits after arriving into the end station
+    int waitBeforeStart = 10000;    ///< Default headway, how much milliseconds a bus waits when leaving the start station after another bus leaves
+    int fleetSize = 10;             ///< Default number of buses created from one bus entry
 
     QJsonObject json;
+    QByteArray mapDigest;   ///< Hash of the map file, identifies files of the persistent route cache
     Pathfinding p;      ///< Variable for Pathfinding object
+    ContractionHierarchy ch;    ///< Contraction hierarchy built over the graph of "p", used for route queries
+
+    /*!
+     * \brief The RouteWorkspace structure
+     * \details Search state of both routing algorithms and the buffer for assembling paths of lines,
+     * every thread computing routes uses its own workspace. Buffers are reused by following queries.
+     */
+    struct RouteWorkspace {
+        Pathfinding::Workspace astar;
+        ContractionHierarchy::Workspace hierarchy;
+        QVector<std::tuple<int,int>> path;
+    };
+    RouteWorkspace routeWorkspace;  ///< Workspace for routes computed on the GUI thread
+    mutable LegCache legCache;          ///< Routes of legs shared by all lines, filled by route queries
+    AlternativeRoutes alternatives;     ///< Routes of legs of lines computed when the map is loaded, used while routing ignores traffic
+    QMap<std::tuple<int,int>, DStarLite> replanners;    ///< Incremental searches towards stations (key is the coordinate), shared by buses heading to the station
     QPen pen;
 
     bool editMode = false;              ///< Switch for enabling/disabling line editation mode
+    bool trafficRouting = false;        ///< Switch for routing lines around streets with heavy traffic
     line* selectedLine = nullptr;
     street* selectedStreet = nullptr;
     QVector<QString> routeEditTemp;     ///< Temporary variable for new line when in line edit mode
 
-    KeyGen renderedItemsKeyGen; ///< Generates key for all rendered items stored in variable "renderedItems"
-    KeyGen busKeyGen;           ///< Generates key for buses stored in variable "buses"
-
     QMap<QString, street> streets;                  ///< Stores all streets
     QMap<QString, stop> stops;                      ///< Stores all stops (key is the coordinate)
     QMap<std::tuple<int,int>, stop> stopsReversed;  ///< Stores all stops (key is the name)
     QMap<int, line> lines;                          ///< Stores all lines
-    QMap<int, bus> buses;                           ///< Stores all buses
+    QVector<bus> buses;                             ///< Stores all buses (key is the index), allocated at once when loading
     QVector<std::tuple<int,int>> points;            ///< Stores all points on the map (which are not stations)
     QGraphicsItem * selectedItem = nullptr;
     QGraphicsItem * lastSelectedItem = nullptr;
-    QMap<int,container> renderedItems;              ///< Stores all rendered items
-
-    /*!
-     * \brief loads background, lines and vehicles
-     */
-    void loadAll();
+    QVector<container> renderedItems;               ///< Stores all selectable rendered items (index is the key of the item)
+    PickIndex pickIndex;                            ///< Finds selectable items under the cursor
+    QElapsedTimer paintTimer;                       ///< Measures rendering of the scene when profiling is enabled
+    double viewScale = 1.0;                         ///< Scale of the view, items of buses move only by whole pixels of the view
+    QRectF renderRect;                              ///< Visible part of the scene with a margin, only items of buses inside are updated
+    QRectF mapBounds;                               ///< Bounding rectangle of all stops and streets
+    SpatialGrid itemGrid;                           ///< Positions of items of buses, which may lag behind buses outside of the view
+    QVector<int> renderedAt;                        ///< Number of the last render pass which updated the bus (index is the bus key)
+    QVector<int> visible;                           ///< Keys of buses visited by the current render pass
+    int renderPass = 0;
+
+    /*!
+     * \brief The BusFrame structure
+     * \details State of a bus needed by the GUI thread.
+     */
+    struct BusFrame {
+        double pos_x;
+        double pos_y;
+        bool halt;
+        QString currStreet;
+        QString startStation;
+        QString endStation;
+        QString lastStation;
+        QString headingStation;
+    };
+
+    /*!
+     * \brief The LineFrame structure
+     * \details State of a line needed by the GUI thread, containers are shared with the model until it changes them.
+     */
+    struct LineFrame {
+        QString start;
+        QVector<QString> stopsAt;
+        QString end;
+        QVector<std::tuple<int,int,int,int>> pathLines;
+    };
+
+    /*!
+     * \brief The Frame structure
+     * \details Snapshot of all buses, lines and traffic of streets published by the simulation after every tick
+     * and command. The GUI thread reads only frames, so it never waits for routing done by the simulation.
+     */
+    struct Frame {
+        int number = 0;
+        QVector<BusFrame> buses;    ///< Index is the bus key
+        QMap<int, LineFrame> lines; ///< Key is the number of the line
+        QMap<QString, int> traffic; ///< Key is the name of the street
+        SpatialGrid grid;           ///< Positions of buses (index is the bus key), buses are moved between its cells
+    };
+
+    QMutex modelMutex;                  ///< Guards the model shared by the GUI thread and the simulation thread
+    QThread simulationThread;
+    SimulationWorker *worker = nullptr; ///< Lives on the simulation thread, created by play()
+    bool running = false;
+    int tickInterval;                   ///< Milliseconds between ticks of the simulation
+    TripleBuffer<Frame> frames;         ///< Written by the simulation, read by the GUI thread
+    int frameNumber = 0;
+    QTimer *frameTimer;                 ///< Takes published frames at the repaint cadence
+
+    CommandQueue<command> commands;             ///< Posted by any thread, taken by the simulation
+    std::atomic<qint64> commandSequence {0};
+    QVector<command> pendingCommands;           ///< Heap of taken commands waiting for their time
+    QVector<command> commandLog;                ///< Applied commands in the order of application
+
+    /*!
+     * \brief loads background, lines and vehicles, builds the routing graph and routes lines
+     * \param stage called when a stage starts, returns false if loading should stop
+     * \param cancelled routing stops at its next job once the flag is set (may be nullptr)
+     * \return false if loading was stopped
+     */
+    bool loadAll(const std::function<bool(int)>& stage, const std::atomic<bool> *cancelled);
 
     /*!
      * \brief loads background
@@ -100,7 +207,7 @@ private:
     void renderStops();
 
     /*!
-     * \brief renders lines
+     * \brief renders paths of lines from the latest taken frame
      */
     void renderLines();
 
@@ -121,6 +228,72 @@ private:
      */
     void setNewPosition(bus &bus, double step = 1);
 
+    /*!
+     * \brief moves the item of the bus to its position in the current frame if it differs by at least one pixel of the view
+     * \param key
+     */
+    void updateBusItem(int key);
+
+    /*!
+     * \brief publishes positions of buses for the GUI thread
+     * \details called with the model locked
+     */
+    void publishFrame();
+
+    /*!
+     * \brief takes posted commands and applies the ones whose time has come
+     * \details called with the model locked at the boundary of ticks
+     * \return true if paths of lines should be rendered again
+     */
+    bool applyCommands();
+
+    /*!
+     * \brief applies the command to the model
+     * \param c
+     * \return true if paths of lines should be rendered again
+     */
+    bool applyCommand(const command& c);
+
+    /*!
+     * \brief applies posted commands outside of ticks, so commands take effect while the simulation is paused
+     * \details runs on the simulation thread, or on the calling thread if the simulation thread was not started
+     */
+    void runCommands();
+
+    /*!
+     * \brief returns true if the command "a" is applied after the command "b"
+     * \details used by the heap of pending commands
+     */
+    static bool laterCommand(const command& a, const command& b);
+
+    /*!
+     * \brief returns the time of the day in milliseconds
+     * \return
+     */
+    int getTimeMs() const;
+
+    /*!
+     * \brief resets time and vehicles and routes all lines
+     * \details called with the model locked
+     */
+    void resetModel();
+
+    /*!
+     * \brief routes all lines in both directions
+     * \details paths of lines contain both directions afterwards, so renderLines() draws both of them
+     * \param assignPath true if buses should follow the computed paths
+     * \param cancelled routing stops at its next job once the flag is set (may be nullptr)
+     * \return false if routing was cancelled, paths are not changed then
+     */
+    bool routeLines(bool assignPath, const std::atomic<bool> *cancelled = nullptr);
+
+    /*!
+     * \brief implements jumpTo() with the model locked
+     * \param second
+     * \return number of processed events
+     */
+    qint64 runEvents(int second);
+
     /*!
      * \brief gets new path for bus
      * \details uses the A* pathfinding algorithm declared in the "pathfinding.h" file
@@ -129,6 +302,45 @@ private:
      */
     QVector<std::tuple<int,int,int,int>> getPath(bus &bus);
 
+    /*!
+     * \brief finds a route between two points
+     * \details returns the cached route of the leg if there is one, then the shortest open alternative route of the leg,
+     * otherwise queries the contraction hierarchy, falls back to the A* algorithm if the hierarchy is not built.
+     * When routing around traffic is enabled and streets have traffic profiles, the time-dependent A* is used.
+     * \param start
+     * \param end
+     * \param departure departure time in seconds of the day, moved to the arrival time by time-dependent queries
+     * \return points of the route
+     */
+    QVector<std::tuple<int,int>> findRoute(std::tuple<int,int> start, std::tuple<int,int> end, double &departure, RouteWorkspace &workspace) const;
+
+    /*!
+     * \brief computes the path of a line
+     * \details does not modify the scene, can run concurrently with other calls using different workspaces
+     * \param lineno number of the line
+     * \param reversed true if the path goes from the end station to the start station
+     * \param departure departure time from the first station in seconds of the day
+     * \param halt set to true if the route is not correct
+     * \param workspace
+     * \return path for a bus to follow
+     */
+    QVector<std::tuple<int,int,int,int>> computePath(int lineno, bool reversed, double departure, bool &halt, RouteWorkspace &workspace) const;
+
+    /*!
+     * \brief computes paths of all buses in parallel
+     * \details paths are computed once per line (or per departure time with time-dependent routing) on the global thread pool
+     * \param reversed true if paths go from the end station to the start station
+     * \param assignPath true if buses should follow computed paths, otherwise paths are used only to render lines
+     * \param cancelled jobs not started yet are skipped once the flag is set (may be nullptr)
+     * \return false if routing was cancelled, paths are not changed then
+     */
+    bool routeBuses(bool reversed, bool assignPath, const std::atomic<bool> *cancelled = nullptr);
+
+    /*!
+     * \brief evaluates traffic profiles of all streets at the current time
+     */
+    void updateTrafficProfiles();
+
     /*!
      * \brief returns a name of a station where the bus is heading to
      * \param bus b
@@ -136,6 +348,57 @@ private:
      */
     QString getBusHeadingTo(const bus &b);
 
+    /*!
+     * \brief applies traffic of the street to the routing graph
+     * \details traffic is used as a factor of street lengths only when routing around traffic is enabled
+     * \param s street
+     */
+    void applyStreetTraffic(const street &s);
+
+    /*!
+     * \brief recomputes routes of all lines with current street weights
+     * \details buses waiting in their start station take the new route right away (and start again if it exists),
+     * buses on the road are rerouted by rerouteBuses()
+     */
+    void replanLines();
+
+    /*!
+     * \brief returns true if the bus did not leave its start station yet
+     * \param bus
+     * \return
+     */
+    bool inStartStation(const bus &bus) const;
+
+    /*!
+     * \brief passes changed edges of the street to all incremental searches
+     * \param name name of the street
+     */
+    void updateReplanners(const QString &name);
+
+    /*!
+     * \brief finds a route from any point of the map to a station by the incremental search of the station
+     * \details a point inside a chain of segments continues to the cheaper end of the chain first
+     * \param point
+     * \param goal coordinates of the station
+     * \param ok set to false if the station is not reachable
+     * \return points of the route
+     */
+    QVector<std::tuple<int,int>> replanFrom(std::tuple<int,int> point, std::tuple<int,int> goal, bool &ok);
+
+    /*!
+     * \brief reroutes the bus on the road from the next point it reaches
+     * \details the leg to the next station is replanned incrementally, remaining legs are routed as usual.
+     * The bus halts if a station is not reachable and continues once it is reachable again.
+     * \param bus
+     * \return true if the bus is on the road and got a new path
+     */
+    bool rerouteBus(bus &bus);
+
+    /*!
+     * \brief reroutes all buses on the road after streets changed
+     */
+    void rerouteBuses();
+
 public slots:
 
     /*!
@@ -165,12 +428,85 @@ public slots:
      */
     void setTraffic(int s);
 
+    /*!
+     * \brief enables or disables routing of lines around streets with heavy traffic
+     * \param val
+     */
+    void setTrafficRouting(bool val);
+
     /*!
      * \brief simulates the scene
      * \param step speed of the simulation
      */
     void simulate(double step = 1);
 
+    /*!
+     * \brief updates items of buses inside the visible part of the scene
+     * \details buses and items are found by grids of their positions, items of other buses keep their old position
+     * until the bus or the item gets into the view. Called for every new frame and after the view is scrolled or zoomed.
+     */
+    void renderBuses();
+
+    /*!
+     * \brief resets the simulation and runs it to the given time by the discrete-event engine
+     * \details buses jump from one event (departure, end of a route segment) to the next instead of moving
+     * in every tick, so long runs of large fleets are fast. Used by the headless mode, locks the model,
+     * must be called from the GUI thread.
+     * \param second time of the day in seconds
+     * \return number of processed events
+     */
+    qint64 jumpTo(int second);
+
+    /*!
+     * \brief closes the profiled tick
+     * \details does nothing unless profiling is enabled
+     */
+    void profileTick();
+
+    /*!
+     * \brief starts the simulation on its thread
+     */
+    void play();
+
+    /*!
+     * \brief pauses the simulation
+     */
+    void pause();
+
+    /*!
+     * \brief changes the interval between ticks of the simulation
+     * \param interval milliseconds
+     */
+    void setInterval(int interval);
+
+    /*!
+     * \brief runs one tick of the simulation
+     */
+    void step();
+
+    /*!
+     * \brief moves the simulation forward
+     * \param ms milliseconds
+     */
+    void skip(int ms);
+
+    /*!
+     * \brief moves the simulation back by replaying it from the start by the discrete-event engine
+     * \param seconds
+     */
+    void rewind(int seconds);
+
+private slots:
+    /*!
+     * \brief takes the latest frame published by the simulation and updates items of buses
+     */
+    void renderFrame();
+
+    /*!
+     * \brief takes the latest frame and renders paths of all lines again
+     */
+    void redrawLines();
+
 public:
     /*!
      * \brief constuctor
@@ -185,6 +521,35 @@ public:
      */
     ~Scene();
 
+    /*!
+     * \brief Stages of loading a map, reported in this order
+     */
+    enum LoadStage {
+        Parsing,
+        BuildingGraph,
+        Routing,
+        CreatingItems,
+        LoadStageCount
+    };
+
+    /*!
+     * \brief loads the map without creating graphics items
+     * \details called by the constructor when a path is given, otherwise it may run on any thread
+     * while the scene is not shown and the simulation does not run. Cancellation is checked when a stage starts
+     * and before every routing job.
+     * \param path path to the map
+     * \param progress receives the stage which starts (may be empty), called on the loading thread
+     * \param cancelled loading stops at the next stage once the flag is set (may be nullptr)
+     * \return false if loading was cancelled
+     */
+    bool loadModel(QString path, std::function<void(int)> progress = nullptr, const std::atomic<bool> *cancelled = nullptr);
+
+    /*!
+     * \brief creates graphics items of the loaded map and publishes the first frame
+     * \details called on the GUI thread after loadModel()
+     */
+    void createItems();
+
     int interval_ms;
 
     /*!
@@ -192,13 +557,45 @@ public:
      * \return time
      */
     int getTime();
-    QTimer *timer;
+
+    /*!
+     * \brief returns true if the simulation is running (not paused)
+     * \return
+     */
+    bool isRunning() const;
+
+    /*!
+     * \brief posts the command to the simulation, can be called from any thread
+     * \param c
+     */
+    void post(command c);
+
+    /*!
+     * \brief posts commands in their order, cheaper than posting them one by one
+     * \param batch
+     */
+    void post(QVector<command> batch);
+
+    /*!
+     * \brief returns applied commands with times of their application
+     * \return
+     */
+    QVector<command> getCommandLog();
+
+    /*!
+     * \brief posts logged commands again to be applied at the same times of the day
+     * \details after a reset the simulation repeats the logged run exactly
+     * \param log commands returned by getCommandLog()
+     */
+    void replay(const QVector<command>& log);
 
     /*!
      * \brief gets buses from scene
+     * \details returns a read-only reference, iterating over the fleet does not copy it.
+     * Only fields which do not change during the simulation may be read while the simulation is running.
      * \return buses
      */
-    QMap<int, bus> getBuses();
+    const QVector<bus>& getBuses() const;
 
     /*!
      * \brief gets info about specific bus
@@ -211,7 +608,7 @@ public:
      * \brief gets lines from scene
      * \return lines
      */
-    QMap<int, line> getLines();
+    const QMap<int, line>& getLines() const;
 
     /*!
      * \brief gets info about specific line
@@ -224,7 +621,7 @@ public:
      * \brief gets streets from the scene
      * \return streets
      */
-    QMap<QString, street> getStreets();
+    const QMap<QString, street>& getStreets() const;
 
     /*!
      * \brief gets name of the specific street
@@ -233,6 +630,23 @@ public:
      */
     QString getStreetInfo(QString key);
 
+    /*!
+     * \brief computes distances between every pair of stops
+     * \details all routes are computed in one batch by ContractionHierarchy::distanceMatrix()
+     * \param names receives names of stops in order of rows and columns of the matrix
+     * \return row-major matrix of distances, INFINITY if there is no route between stops
+     */
+    QVector<float> getStopDistances(QVector<QString>& names);
+
+    /*!
+     * \brief exports distances between every pair of stops into a binary file
+     * \details little endian file: magic "ICPM", uint32 stop count, stop names (uint32 length + UTF-8 bytes)
+     * and a dense row-major matrix of float32 distances
+     * \param path path to the output file
+     * \return true if the file was written, otherwise false
+     */
+    bool exportStopDistances(QString path);
+
     /*!
      * \brief gets selected line
      * \return selected line
@@ -322,6 +736,8 @@ public:
 
 protected:
     virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
+    virtual void drawBackground(QPainter *painter, const QRectF &rect) override;
+    virtual void drawForeground(QPainter *painter, const QRectF &rect) override;
 
 signals:
     void valueChanged(int newValue);
@@ -0,0 +1,38 @@
+/*!
+ * @file simulationworker.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Simulation thread worker
+ */
+
+#include "simulationworker.h"
+
+SimulationWorker::SimulationWorker(std::function<void()> tick) : QObject(nullptr), tick(tick) {}
+
+
+void SimulationWorker::start(int interval)
+{
+    if (!timer) {
+        timer = new QTimer(this);
+        connect(timer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+    }
+    timer->start(interval);
+}
+
+
+void SimulationWorker::stop()
+{
+    if (timer) timer->stop();
+}
+
+
+void SimulationWorker::setInterval(int interval)
+{
+    if (timer) timer->setInterval(interval);
+}
+
+
+void SimulationWorker::onTimeout()
+{
+    tick();
+}
@@ -0,0 +1,56 @@
+/*!
+ * @file simulationworker.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the simulation thread worker
+ */
+
+#ifndef SIMULATIONWORKER_H
+#define SIMULATIONWORKER_H
+
+#include <QObject>
+#include <QTimer>
+#include <functional>
+
+/*!
+ * \brief Runs ticks of the simulation on the thread the worker lives in
+ * \details The worker is moved to the simulation thread, slots are invoked from the GUI thread by queued calls.
+ * Commands of the scene are executed on the same thread between ticks (QMetaObject::invokeMethod() with the worker as the context).
+ */
+class SimulationWorker : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief constructor
+     * \param tick called on every timeout of the simulation timer
+     */
+    explicit SimulationWorker(std::function<void()> tick);
+
+public slots:
+    /*!
+     * \brief starts ticking
+     * \param interval milliseconds between ticks
+     */
+    void start(int interval);
+
+    /*!
+     * \brief stops ticking
+     */
+    void stop();
+
+    /*!
+     * \brief changes the interval between ticks
+     * \param interval milliseconds
+     */
+    void setInterval(int interval);
+
+private slots:
+    void onTimeout();
+
+private:
+    std::function<void()> tick;
+    QTimer *timer = nullptr;    ///< Created on the simulation thread by the first start()
+};
+
+#endif // SIMULATIONWORKER_H
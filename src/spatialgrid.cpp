@@ -0,0 +1,72 @@
+/*!
+ * @file spatialgrid.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Uniform grid of points
+ */
+
+#include "spatialgrid.h"
+
+SpatialGrid::SpatialGrid(double cellSize) : cellSize(cellSize) {}
+
+
+void SpatialGrid::reset(const QRectF& bounds)
+{
+    this->bounds = bounds;
+    columns = std::max(1, int(std::ceil(bounds.width() / cellSize)));
+    rows = std::max(1, int(std::ceil(bounds.height() / cellSize)));
+    cells.resize(columns * rows);
+    for (auto& cell : cells)
+        cell.resize(0);
+}
+
+
+void SpatialGrid::insert(int index, int cell)
+{
+    cellOfPoint[index] = cell;
+    slotOfPoint[index] = cells[cell].size();
+    cells[cell].push_back(index);
+}
+
+
+void SpatialGrid::move(int index, const QPointF& position)
+{
+    auto cell = cellAt(position);
+    if (cell == cellOfPoint[index]) return;
+
+    // the last point of the old cell takes the place of the moved point
+    auto& old = cells[cellOfPoint[index]];
+    auto last = old.last();
+    old[slotOfPoint[index]] = last;
+    slotOfPoint[last] = slotOfPoint[index];
+    old.removeLast();
+
+    insert(index, cell);
+}
+
+
+int SpatialGrid::size() const
+{
+    return cellOfPoint.size();
+}
+
+
+const QRectF& SpatialGrid::getBounds() const
+{
+    return bounds;
+}
+
+
+std::pair<int,int> SpatialGrid::cellIndex(double x, double y) const
+{
+    auto column = int(std::floor((x - bounds.left()) / cellSize));
+    auto row = int(std::floor((y - bounds.top()) / cellSize));
+    return std::pair<int,int>(std::min(std::max(column, 0), columns - 1), std::min(std::max(row, 0), rows - 1));
+}
+
+
+int SpatialGrid::cellAt(const QPointF& point) const
+{
+    auto cell = cellIndex(point.x(), point.y());
+    return cell.second * columns + cell.first;
+}
@@ -0,0 +1,126 @@
+/*!
+ * @file spatialgrid.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the uniform grid of points
+ */
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QRectF>
+#include <QPointF>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+/*!
+ * \brief Uniform grid of indexed points used to find points inside a rectangle
+ * \details Every square cell keeps a list of its points, so building the grid is linear and reuses its buffers
+ * and a moved point changes its cell in constant time. Points outside of the bounds are stored in the nearest
+ * border cell.
+ */
+class SpatialGrid
+{
+public:
+    /*!
+     * \brief constructor
+     * \param cellSize length of a side of a cell
+     */
+    explicit SpatialGrid(double cellSize = 128);
+
+    /*!
+     * \brief sorts points into cells
+     * \param bounds area covered by the grid
+     * \param count number of points
+     * \param position returns QPointF of the point with the given index
+     */
+    template<typename Position>
+    void build(const QRectF& bounds, int count, Position position)
+    {
+        reset(bounds);
+
+        cellOfPoint.resize(count);
+        slotOfPoint.resize(count);
+        for (int i = 0; i < count; ++i)
+            insert(i, cellAt(position(i)));
+    }
+
+    /*!
+     * \brief moves the point into the cell of its new position
+     * \details must not be called while the grid is queried
+     * \param index index of the point
+     * \param position
+     */
+    void move(int index, const QPointF& position);
+
+    /*!
+     * \brief returns number of points
+     * \return
+     */
+    int size() const;
+
+    /*!
+     * \brief returns the area covered by the grid
+     * \return
+     */
+    const QRectF& getBounds() const;
+
+    /*!
+     * \brief visits points in cells intersecting the rectangle
+     * \details points in the border cells may lie outside of the rectangle
+     * \param rect
+     * \param visit called with the index of every point
+     */
+    template<typename Visit>
+    void query(const QRectF& rect, Visit visit) const
+    {
+        if (cellOfPoint.empty()) return;
+
+        auto first = cellIndex(rect.left(), rect.top());
+        auto last = cellIndex(rect.right(), rect.bottom());
+        for (int row = first.second; row <= last.second; ++row)
+        {
+            for (int column = first.first; column <= last.first; ++column)
+            {
+                for (const auto i : cells[row * columns + column])
+                    visit(i);
+            }
+        }
+    }
+
+private:
+    double cellSize;
+    QRectF bounds;
+    int columns = 0;
+    int rows = 0;
+    QVector<QVector<int>> cells;    ///< Indexes of points in every cell
+    QVector<int> cellOfPoint;
+    QVector<int> slotOfPoint;       ///< Position of every point in the list of its cell
+
+    /*!
+     * \brief resizes the grid to cover the bounds and empties all cells
+     * \param bounds
+     */
+    void reset(const QRectF& bounds);
+
+    /*!
+     * \brief appends the point to the cell
+     * \param index index of the point
+     * \param cell index of the cell
+     */
+    void insert(int index, int cell);
+
+    /*!
+     * \brief returns the column and the row of the cell containing the coordinates (clamped to the grid)
+     */
+    std::pair<int,int> cellIndex(double x, double y) const;
+
+    /*!
+     * \brief returns the index of the cell containing the point (clamped to the grid)
+     */
+    int cellAt(const QPointF& point) const;
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,126 @@
+/*!
+ * @file tracer.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Chrome Trace Event recorder
+ */
+
+#include "tracer.h"
+
+Tracer::Tracer() {}
+
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+
+void Tracer::start(QString path)
+{
+    // buffers stay allocated, threads keep pointers to them
+    QMutexLocker locker(&buffersMutex);
+    for (const auto& buffer : buffers)
+    {
+        QMutexLocker bufferLocker(&buffer->mutex);
+        buffer->events.clear();
+    }
+    this->path = path;
+    clock.start();
+    active = true;
+}
+
+
+bool Tracer::stop()
+{
+    if (!active) return false;
+    active = false;
+
+    QMutexLocker locker(&buffersMutex);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"icp\"}}";
+
+    for (const auto& buffer : buffers)
+    {
+        QMutexLocker bufferLocker(&buffer->mutex);
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << (buffer->gui ? QString("GUI") : QString("worker %1").arg(buffer->tid)) << "\"}}";
+
+        for (const auto& event : buffer->events)
+        {
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << QString::number(event.at / 1000.0, 'f', 3);
+            if (event.phase == 'X') {
+                out << ",\"dur\":" << QString::number(event.value / 1000.0, 'f', 3);
+            } else if (event.phase == 'C') {
+                out << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            out << "}";
+        }
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+
+    return true;
+}
+
+
+qint64 Tracer::now() const
+{
+    return clock.nsecsElapsed();
+}
+
+
+void Tracer::begin(const char* name)
+{
+    if (isActive()) record(Event {name, 'B', now(), 0});
+}
+
+
+void Tracer::end(const char* name)
+{
+    if (isActive()) record(Event {name, 'E', now(), 0});
+}
+
+
+void Tracer::complete(const char* name, qint64 startedAt, qint64 duration)
+{
+    record(Event {name, 'X', startedAt, duration});
+}
+
+
+void Tracer::counter(const char* name, qint64 value)
+{
+    record(Event {name, 'C', now(), value});
+}
+
+
+Tracer::Buffer& Tracer::buffer()
+{
+    thread_local Buffer* local = nullptr;
+
+    if (local == nullptr)
+    {
+        QMutexLocker locker(&buffersMutex);
+        auto application = QCoreApplication::instance();
+
+        buffers.emplace_back(new Buffer);
+        local = buffers.back().get();
+        local->tid = int(buffers.size());
+        local->gui = application and QThread::currentThread() == application->thread();
+    }
+    return *local;
+}
+
+
+void Tracer::record(const Event& event)
+{
+    auto& local = buffer();
+    QMutexLocker locker(&local.mutex);
+    local.events.push_back(event);
+}
@@ -0,0 +1,150 @@
+/*!
+ * @file tracer.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Definition of the Chrome Trace Event recorder
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) Tracer::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (Tracer::instance().isActive()) Tracer::instance().counter(name, value); } while (0)
+
+/*!
+ * \brief Records spans and counters into a Chrome Trace Event JSON file.
+ * \details Tracing is opt-in, events are recorded only between start() and stop(), otherwise every span costs
+ * a single atomic load. The written file can be opened offline in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * Events may be recorded from any thread, every thread appends into its own buffer. Buffers live as long as
+ * the process, start() and stop() only empty them, so they may be called while other threads record events.
+ */
+class Tracer
+{
+public:
+    /*!
+     * \brief The Span class
+     * \details Records a complete event between construction and destruction.
+     */
+    class Span
+    {
+    public:
+        explicit Span(const char* name) : name(name), startedAt(Tracer::instance().isActive() ? Tracer::instance().now() : -1) {}
+        ~Span() { if (startedAt >= 0 and Tracer::instance().isActive()) Tracer::instance().complete(name, startedAt, Tracer::instance().now() - startedAt); }
+    private:
+        const char* name;
+        qint64 startedAt;   ///< Nanoseconds since the start of the trace, -1 if the tracer was not active
+    };
+
+    /*!
+     * \brief returns the tracer of the application
+     * \return
+     */
+    static Tracer& instance();
+
+    /*!
+     * \brief starts recording, events recorded by the previous trace are dropped
+     * \param path path to the output file written by stop()
+     */
+    void start(QString path);
+
+    /*!
+     * \brief stops recording and writes the trace
+     * \return true if the file was written, otherwise false
+     */
+    bool stop();
+
+    /*!
+     * \brief returns true while recording
+     * \return
+     */
+    bool isActive() const { return active.load(std::memory_order_relaxed); }
+
+    /*!
+     * \brief returns nanoseconds since the start of the trace
+     * \return
+     */
+    qint64 now() const;
+
+    /*!
+     * \brief records a beginning of a span, the span is closed by end() on the same thread
+     * \param name string literal
+     */
+    void begin(const char* name);
+
+    /*!
+     * \brief records an end of the span started by begin()
+     * \param name string literal
+     */
+    void end(const char* name);
+
+    /*!
+     * \brief records a complete span
+     * \param name string literal
+     * \param startedAt nanoseconds since the start of the trace
+     * \param duration nanoseconds
+     */
+    void complete(const char* name, qint64 startedAt, qint64 duration);
+
+    /*!
+     * \brief records a value of the counter
+     * \param name string literal
+     * \param value
+     */
+    void counter(const char* name, qint64 value);
+
+private:
+    Tracer();
+
+    /*!
+     * \brief The Event structure
+     * \details One record of the trace, names are string literals so recording does not allocate them.
+     */
+    struct Event {
+        const char* name;
+        char phase;             ///< 'X' complete span, 'B' / 'E' begin / end of a span, 'C' counter
+        qint64 at;              ///< Nanoseconds since the start of the trace
+        qint64 value;           ///< Duration of a complete span or value of a counter
+    };
+
+    /*!
+     * \brief The Buffer structure
+     * \details Events of one thread.
+     */
+    struct Buffer {
+        QMutex mutex;
+        QVector<Event> events;
+        int tid;
+        bool gui;
+    };
+
+    std::atomic<bool> active {false};
+    QElapsedTimer clock;
+    QString path;
+    QMutex buffersMutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;   ///< Never shrinks, threads cache pointers to their buffers
+
+    /*!
+     * \brief returns the buffer of the calling thread
+     * \return
+     */
+    Buffer& buffer();
+
+    void record(const Event& event);
+};
+
+#endif // TRACER_H
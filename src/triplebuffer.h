@@ -0,0 +1,61 @@
+/*!
+ * @file triplebuffer.h
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Lock-free triple buffer
+ */
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/*!
+ * \brief Lock-free handoff of the latest value from one writer thread to one reader thread
+ * \details The writer fills the back buffer and publishes it, the reader takes the latest published buffer.
+ * Neither side ever waits for the other one, values published in between reads are skipped.
+ * Buffers are reused, so values holding containers keep their capacity.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    /*!
+     * \brief returns the buffer filled by the writer
+     * \return
+     */
+    T& back() { return buffers[backIndex]; }
+
+    /*!
+     * \brief publishes the back buffer, the writer continues with another buffer
+     */
+    void publish() { backIndex = middle.exchange(backIndex | dirty, std::memory_order_acq_rel) & indexMask; }
+
+    /*!
+     * \brief takes the latest published buffer as the front buffer
+     * \return true if a new buffer was published since the last update
+     */
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & dirty)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    /*!
+     * \brief returns the buffer read by the reader
+     * \return
+     */
+    const T& front() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr int dirty = 4;         ///< Set in "middle" when it holds a buffer the reader did not take yet
+    static constexpr int indexMask = 3;
+
+    T buffers[3];
+    std::atomic<int> middle {1};            ///< Index of the buffer between the writer and the reader
+    int backIndex = 0;                      ///< Used only by the writer
+    int frontIndex = 2;                     ///< Used only by the reader
+};
+
+#endif // TRIPLEBUFFER_H
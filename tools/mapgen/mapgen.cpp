@@ -0,0 +1,339 @@
+/*!
+ * @file mapgen.cpp
+ * @author Peter Koprda (xkoprd00)
+ * @author Adam Múdry (xmudry01)
+ * @brief Generator of large synthetic maps for scale testing
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+
+/*!
+ * \brief The Options struct
+ * \details Parameters of the generated map.
+ */
+struct Options {
+    int size = 100;         ///< Number of intersections in a row/column of the street grid
+    int stops = -1;         ///< Number of stops (-1 for a stop on every intersection)
+    int lines = 200;
+    int buses = 2000;       ///< Number of vehicles, split evenly into fleets of lines
+    int spacing = 40;       ///< Distance between neighbouring intersections
+    bool organic = false;   ///< Jittered intersections, missing blocks and shorter streets instead of a regular grid
+    quint32 seed = 1;
+};
+
+/*!
+ * \brief Generates a map in the format loaded by Scene ("lines", "stops", "streets", "buses").
+ * \details Intersections are laid out in a square grid, rows and columns of intersections are split into streets.
+ * Stops are placed on intersections, lines connect distant stops through stops close to the straight line between them.
+ * All random decisions use one seeded generator, so the same options always produce the same map.
+ */
+class MapGenerator
+{
+public:
+    /*!
+     * \brief constructor
+     * \param options
+     */
+    explicit MapGenerator(const Options& options) : options(options), rng(options.seed) {}
+
+    /*!
+     * \brief generates the map
+     * \return JSON object of the map
+     */
+    QJsonObject generate()
+    {
+        createIntersections();
+        createStreets();
+        createStops();
+        createLines();
+        createBuses();
+
+        return QJsonObject {{"lines", lines}, {"stops", stops}, {"streets", streets}, {"buses", buses}};
+    }
+
+private:
+    Options options;
+    QRandomGenerator rng;
+
+    QVector<std::tuple<int,int>> coords;    ///< Coordinates of intersections (index is row * size + column)
+    QVector<bool> exists;                   ///< False for intersections removed by the organic layout
+    QVector<int> stopAt;                    ///< Index of the stop on the intersection (-1 if there is no stop)
+    QVector<int> stopCells;                 ///< Intersections with stops (index is the stop index)
+
+    QJsonArray lines;
+    QJsonArray stops;
+    QJsonArray streets;
+    QJsonArray buses;
+
+    int cell(int i, int j) const { return j * options.size + i; }
+
+    QJsonArray point(int c) const { return QJsonArray {std::get<0>(coords[c]), std::get<1>(coords[c])}; }
+
+    QString stopName(int s) const { return QString("Stop %1").arg(s + 1); }
+
+    void createIntersections()
+    {
+        const int n = options.size * options.size;
+        coords.resize(n);
+        exists.fill(true, n);
+
+        const int jitter = options.organic ? options.spacing / 4 : 0;
+        for (int j = 0; j < options.size; ++j)
+        {
+            for (int i = 0; i < options.size; ++i)
+            {
+                auto x = options.spacing * (i + 1);
+                auto y = options.spacing * (j + 1);
+                if (jitter > 0) {
+                    x += rng.bounded(-jitter, jitter + 1);
+                    y += rng.bounded(-jitter, jitter + 1);
+                    exists[cell(i, j)] = rng.bounded(100) >= 4;
+                }
+                coords[cell(i, j)] = std::tuple<int,int>(x, y);
+            }
+        }
+    }
+
+    /*!
+     * \brief splits a row or a column of intersections into streets
+     * \param cells intersections of the row/column in order
+     */
+    void createStreetsAlong(const QVector<int>& cells)
+    {
+        QVector<int> polyline;
+        auto maxLength = options.organic ? 2 + int(rng.bounded(8)) : 5 + int(rng.bounded(16));
+
+        auto flush = [this, &polyline]() {
+            if (polyline.size() >= 2) {
+                QJsonArray mid;
+                for (int k = 1; k < polyline.size() - 1; ++k)
+                    mid.append(point(polyline[k]));
+
+                streets.append(QJsonObject {{"name", QString("Street %1").arg(streets.size() + 1)},
+                                            {"start", point(polyline.first())},
+                                            {"mid", mid},
+                                            {"end", point(polyline.last())}});
+            }
+            polyline.clear();
+        };
+
+        for (const auto c : cells)
+        {
+            if (!exists[c]) {
+                flush();
+                continue;
+            }
+
+            // organic layout drops some blocks, the street continues on the other side of the gap
+            if (options.organic and !polyline.empty() and rng.bounded(100) < 5) {
+                flush();
+            }
+
+            polyline.push_back(c);
+            if (polyline.size() > maxLength) {
+                flush();
+                polyline.push_back(c);
+                maxLength = options.organic ? 2 + int(rng.bounded(8)) : 5 + int(rng.bounded(16));
+            }
+        }
+        flush();
+    }
+
+    void createStreets()
+    {
+        for (int k = 0; k < options.size; ++k)
+        {
+            QVector<int> row;
+            QVector<int> column;
+            for (int l = 0; l < options.size; ++l)
+            {
+                row.push_back(cell(l, k));
+                column.push_back(cell(k, l));
+            }
+            createStreetsAlong(row);
+            createStreetsAlong(column);
+        }
+    }
+
+    void createStops()
+    {
+        QVector<int> candidates;
+        for (int c = 0; c < coords.size(); ++c)
+        {
+            if (exists[c]) candidates.push_back(c);
+        }
+
+        // partial Fisher-Yates shuffle picks the stops
+        const int count = options.stops < 0 ? candidates.size() : std::min(options.stops, candidates.size());
+        for (int k = 0; k < count; ++k)
+        {
+            std::swap(candidates[k], candidates[k + int(rng.bounded(candidates.size() - k))]);
+        }
+        candidates.resize(count);
+        std::sort(candidates.begin(), candidates.end());
+
+        stopAt.fill(-1, coords.size());
+        for (const auto c : candidates)
+        {
+            stopAt[c] = stopCells.size();
+            stops.append(QJsonObject {{"name", stopName(stopCells.size())},
+                                      {"x", std::get<0>(coords[c])},
+                                      {"y", std::get<1>(coords[c])}});
+            stopCells.push_back(c);
+        }
+    }
+
+    /*!
+     * \brief finds the stop closest to the given intersection
+     * \return index of the stop, -1 if there is no stop in the search radius
+     */
+    int nearestStop(int i, int j) const
+    {
+        for (int radius = 0; radius < options.size; ++radius)
+        {
+            for (int dj = -radius; dj <= radius; ++dj)
+            {
+                for (int di = -radius; di <= radius; ++di)
+                {
+                    if (std::max(std::abs(di), std::abs(dj)) != radius) continue;
+
+                    auto ci = i + di;
+                    auto cj = j + dj;
+                    if (ci < 0 or cj < 0 or ci >= options.size or cj >= options.size) continue;
+                    if (stopAt[cell(ci, cj)] >= 0) return stopAt[cell(ci, cj)];
+                }
+            }
+        }
+        return -1;
+    }
+
+    void createLines()
+    {
+        static const QStringList colors {"red", "blue", "orange", "green", "magenta", "darkCyan",
+                                         "brown", "purple", "darkGreen", "navy", "olive", "teal"};
+        if (stopCells.size() < 2) return;
+
+        for (int no = 1; no <= options.lines; ++no)
+        {
+            // prefer distant terminals
+            int start = 0;
+            int end = 0;
+            int bestDistance = -1;
+            for (int attempt = 0; attempt < 8; ++attempt)
+            {
+                auto a = int(rng.bounded(stopCells.size()));
+                auto b = int(rng.bounded(stopCells.size()));
+                auto distance = std::abs(stopCells[a] % options.size - stopCells[b] % options.size)
+                              + std::abs(stopCells[a] / options.size - stopCells[b] / options.size);
+                if (a != b and distance > bestDistance) {
+                    start = a;
+                    end = b;
+                    bestDistance = distance;
+                }
+            }
+
+            const int i0 = stopCells[start] % options.size;
+            const int j0 = stopCells[start] / options.size;
+            const int i1 = stopCells[end] % options.size;
+            const int j1 = stopCells[end] / options.size;
+
+            QJsonArray goes;
+            QVector<int> used {start, end};
+            const int midCount = 2 + int(rng.bounded(6));
+            for (int k = 1; k <= midCount; ++k)
+            {
+                auto s = nearestStop(i0 + (i1 - i0) * k / (midCount + 1), j0 + (j1 - j0) * k / (midCount + 1));
+                if (s < 0 or used.contains(s)) continue;
+
+                used.push_back(s);
+                goes.append(stopName(s));
+            }
+
+            const int fleet = options.buses / options.lines + (no <= options.buses % options.lines ? 1 : 0);
+            lines.append(QJsonObject {{"no", no},
+                                      {"color", colors[(no - 1) % colors.size()]},
+                                      {"start", stopName(start)},
+                                      {"goes", goes},
+                                      {"end", stopName(end)},
+                                      {"fleet", fleet},
+                                      {"headway", 5 + int(rng.bounded(16))},
+                                      {"layover", 3}});
+        }
+    }
+
+    void createBuses()
+    {
+        if (lines.isEmpty()) return;
+
+        // one entry per line dispatches the whole fleet of the line
+        for (int b = 0; b < lines.size(); ++b)
+        {
+            buses.append(QJsonObject {{"no", b + 1},
+                                      {"lineno", b + 1},
+                                      {"startat", int(rng.bounded(60))}});
+        }
+    }
+};
+
+
+/*!
+ * \brief Parses options, generates the map and writes it into the output file (or the standard output).
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mapgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates synthetic maps for the public transport simulator.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"layout", "Street layout: grid or organic.", "layout", "grid"},
+        {"size", "Number of intersections in a row of the street grid.", "n", "100"},
+        {"stops", "Number of stops (default: a stop on every intersection).", "n", "-1"},
+        {"lines", "Number of lines.", "n", "200"},
+        {"buses", "Number of buses.", "n", "2000"},
+        {"spacing", "Distance between intersections.", "n", "40"},
+        {"seed", "Seed of the random generator.", "n", "1"},
+        {"compact", "Write compact JSON."},
+        {{"o", "output"}, "Output file (default: standard output).", "file"},
+    });
+    parser.process(app);
+
+    Options options;
+    options.organic = parser.value("layout") == "organic";
+    options.size = std::max(2, parser.value("size").toInt());
+    options.stops = parser.value("stops").toInt();
+    options.lines = std::max(0, parser.value("lines").toInt());
+    options.buses = std::max(0, parser.value("buses").toInt());
+    options.spacing = std::max(8, parser.value("spacing").toInt());
+    options.seed = parser.value("seed").toUInt();
+
+    MapGenerator generator(options);
+    auto json = QJsonDocument(generator.generate()).toJson(parser.isSet("compact") ? QJsonDocument::Compact : QJsonDocument::Indented);
+
+    QFile file;
+    if (parser.isSet("output")) {
+        file.setFileName(parser.value("output"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot open " << parser.value("output") << "\n";
+            return 1;
+        }
+    } else {
+        file.open(stdout, QIODevice::WriteOnly);
+    }
+    file.write(json);
+    return 0;
+}
@@ -0,0 +1,12 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++1z console
+CONFIG -= app_bundle
+
+TARGET = mapgen
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    mapgen.cpp